@@ -23,12 +23,20 @@
       '<@(tflite_include_dir)/tflite/c/eager/c_api.h',
     ],
     'ARCH': '<!(node -e "console.log(process.arch)")',
+    # Set to 'true' (node-gyp rebuild --image_decoding=true) to build
+    # decodeImage() with the system's libjpeg (or libjpeg-turbo) and libpng.
+    'image_decoding%': 'false',
     'tflite-library-action': 'move'
   },
   'targets' : [{
     'target_name' : 'node_tflite_binding',
     'sources' : [
-      'binding/node_tflite_binding.cc'
+      'binding/node_tflite_binding.cc',
+      'binding/tensor_conversion.cc',
+      'binding/image_preprocessing.cc',
+      'binding/image_decoding.cc',
+      'binding/postprocessing.cc',
+      'binding/thread_affinity.cc'
     ],
     'include_dirs' : [
         '..',
@@ -39,11 +47,19 @@
     'cflags!': [ '-fno-exceptions' ], # Remove flags that disable exceptions.
     'cflags_cc!': [ '-fno-exceptions' ],
     'conditions' : [
+      [
+        'image_decoding=="true"', {
+          'defines': [ 'TFLITE_NODE_IMAGE_DECODING' ],
+          'libraries': [ '-ljpeg', '-lpng' ]
+        }
+      ],
       [
         'OS=="linux" and ARCH=="x64"', {
           'cflags+': [ '-std=c++11', '-fexceptions' ],
           'cflags_c+': [ '-std=c++11', '-fexceptions' ],
           'cflags_cc+': [ '-std=c++11', '-fexceptions' ],
+          # This library includes the XNNPACK delegate. The macOS one doesn't.
+          'defines': [ 'TFLITE_NODE_XNNPACK' ],
           'libraries' : [
             '<(module_root_dir)/cc_deps/linux_amd64/libtensorflowlite_c.so',
             '<(module_root_dir)/cc_deps/linux_amd64/libexternal_delegate_obj.so',
@@ -56,6 +72,8 @@
           'cflags+': [ '-std=c++11', '-fexceptions' ],
           'cflags_c+': [ '-std=c++11', '-fexceptions' ],
           'cflags_cc+': [ '-std=c++11', '-fexceptions' ],
+          # This library includes the XNNPACK delegate. The macOS one doesn't.
+          'defines': [ 'TFLITE_NODE_XNNPACK' ],
           'libraries' : [
             '<(module_root_dir)/cc_deps/linux_arm64/libtensorflowlite_c.so',
             '<(module_root_dir)/cc_deps/linux_arm64/libexternal_delegate_obj.so',
@@ -104,7 +122,7 @@
       ],
       [
         'OS=="win" and ARCH=="x64"', {
-          'defines': ['COMPILER_MSVC', 'WIN'],
+          'defines': ['COMPILER_MSVC', 'WIN', 'TFLITE_NODE_XNNPACK'],
           'libraries': [
             '<(module_root_dir)/cc_deps/windows_amd64/tensorflowlite_c.dll.if.lib',
             '<(module_root_dir)/cc_deps/windows_amd64/external_delegate_obj.dll.if.lib',
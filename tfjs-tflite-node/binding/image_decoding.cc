@@ -0,0 +1,235 @@
+/**
+ * @license
+ * Copyright 2022 Google LLC. All Rights Reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * =============================================================================
+ */
+
+#include "image_decoding.h"
+
+#ifdef TFLITE_NODE_IMAGE_DECODING
+
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <jpeglib.h>
+#include <png.h>
+
+namespace image_decoding {
+namespace {
+
+/**
+ * Decoded pixels in a format image_preprocessing can read.
+ */
+struct Decoded {
+  std::vector<uint8_t> pixels;
+  int width = 0;
+  int height = 0;
+  image_preprocessing::PixelFormat format = image_preprocessing::kRgb;
+};
+
+bool isJpeg(const uint8_t *data, size_t size) {
+  return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+bool withinPixelLimit(uint64_t width, uint64_t height,
+                      const Options &options) {
+  return width * height <= options.maxPixels;
+}
+
+std::string checkPixels(uint64_t width, uint64_t height,
+                        const Options &options) {
+  if (!withinPixelLimit(width, height, options)) {
+    return "The image is " + std::to_string(width) + "x"
+        + std::to_string(height) + " pixels, more than the limit of "
+        + std::to_string(options.maxPixels) + " pixels";
+  }
+  return "";
+}
+
+bool isPng(const uint8_t *data, size_t size) {
+  static const uint8_t kSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A,
+                                       '\n'};
+  return size >= sizeof(kSignature)
+      && std::memcmp(data, kSignature, sizeof(kSignature)) == 0;
+}
+
+/**
+ * libjpeg reports fatal errors by calling error_exit, which must not return.
+ * It jumps back to decodeJpeg() with the formatted message instead.
+ */
+struct JpegErrorManager {
+  jpeg_error_mgr base;
+  std::jmp_buf jump;
+  char message[JMSG_LENGTH_MAX];
+};
+
+void onJpegError(j_common_ptr cinfo) {
+  JpegErrorManager *error = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+  (*cinfo->err->format_message)(cinfo, error->message);
+  std::longjmp(error->jump, 1);
+}
+
+void onJpegMessage(j_common_ptr cinfo, int level) {
+  // Ignore warnings about corrupt data. libjpeg still decodes what it can.
+}
+
+/**
+ * The largest DCT scaling denominator (8, 4 or 2) that keeps the image at
+ * least 'width' x 'height', or 1 if it can not be scaled down.
+ */
+unsigned int dctScaleDenominator(const jpeg_decompress_struct &cinfo,
+                                 int width, int height) {
+  for (unsigned int denominator = 8; denominator > 1; denominator /= 2) {
+    JDIMENSION scaledWidth = (cinfo.image_width + denominator - 1)
+        / denominator;
+    JDIMENSION scaledHeight = (cinfo.image_height + denominator - 1)
+        / denominator;
+    if (scaledWidth >= static_cast<JDIMENSION>(width)
+        && scaledHeight >= static_cast<JDIMENSION>(height)) {
+      return denominator;
+    }
+  }
+  return 1;
+}
+
+std::string decodeJpeg(const uint8_t *data, size_t size,
+                       const image_preprocessing::Output &output,
+                       const Options &options, Decoded *image) {
+  jpeg_decompress_struct cinfo;
+  JpegErrorManager error;
+  cinfo.err = jpeg_std_error(&error.base);
+  error.base.error_exit = onJpegError;
+  error.base.emit_message = onJpegMessage;
+  if (setjmp(error.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return std::string("Failed to decode JPEG: ") + error.message;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data),
+               static_cast<unsigned long>(size));
+  jpeg_read_header(&cinfo, TRUE);
+  // Nothing with a destructor may be live from here on, because libjpeg
+  // longjmps back to the setjmp above on errors.
+  if (!withinPixelLimit(cinfo.image_width, cinfo.image_height, options)) {
+    jpeg_destroy_decompress(&cinfo);
+    return checkPixels(cinfo.image_width, cinfo.image_height, options);
+  }
+  // Grayscale JPEGs are decoded as they are, and expanded to RGB by the
+  // preprocessing if the model wants color.
+  bool gray = output.channels == 1 || cinfo.jpeg_color_space == JCS_GRAYSCALE;
+  cinfo.out_color_space = gray ? JCS_GRAYSCALE : JCS_RGB;
+  if (options.dctScaling) {
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = dctScaleDenominator(cinfo, output.width,
+                                            output.height);
+  }
+  jpeg_start_decompress(&cinfo);
+
+  image->width = cinfo.output_width;
+  image->height = cinfo.output_height;
+  image->format = gray ? image_preprocessing::kGray : image_preprocessing::kRgb;
+  size_t stride = static_cast<size_t>(cinfo.output_width)
+      * cinfo.output_components;
+  image->pixels.resize(stride * cinfo.output_height);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = &image->pixels[stride * cinfo.output_scanline];
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return "";
+}
+
+std::string decodePng(const uint8_t *data, size_t size,
+                      const Options &options, Decoded *image) {
+  png_image png;
+  std::memset(&png, 0, sizeof(png));
+  png.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_memory(&png, data, size)) {
+    return std::string("Failed to decode PNG: ") + png.message;
+  }
+  std::string tooLarge = checkPixels(png.width, png.height, options);
+  if (!tooLarge.empty()) {
+    png_image_free(&png);
+    return tooLarge;
+  }
+  // Alpha is dropped by the preprocessing, as it is for RGBA pixels.
+  png.format = PNG_FORMAT_RGBA;
+  image->width = png.width;
+  image->height = png.height;
+  image->format = image_preprocessing::kRgba;
+  image->pixels.resize(PNG_IMAGE_SIZE(png));
+  if (!png_image_finish_read(&png, nullptr, image->pixels.data(), 0,
+                             nullptr)) {
+    std::string message = png.message;
+    png_image_free(&png);
+    return "Failed to decode PNG: " + message;
+  }
+  return "";
+}
+
+}  // namespace
+
+bool isSupported() {
+  return true;
+}
+
+std::string decodeInto(const uint8_t *data, size_t size,
+                       const image_preprocessing::Options &preprocessing,
+                       const image_preprocessing::Output &output,
+                       const Options &options) {
+  Decoded image;
+  std::string error;
+  if (isJpeg(data, size)) {
+    error = decodeJpeg(data, size, output, options, &image);
+  } else if (isPng(data, size)) {
+    error = decodePng(data, size, options, &image);
+  } else {
+    error = "Expected a JPEG or PNG image";
+  }
+  if (!error.empty()) {
+    return error;
+  }
+
+  image_preprocessing::Options decodedOptions = preprocessing;
+  decodedOptions.format = image.format;
+  return image_preprocessing::preprocess(
+      {image.pixels.data(), image.width, image.height},
+      {0, 0, image.width, image.height}, decodedOptions, output);
+}
+
+}  // namespace image_decoding
+
+#else  // TFLITE_NODE_IMAGE_DECODING
+
+namespace image_decoding {
+
+bool isSupported() {
+  return false;
+}
+
+std::string decodeInto(const uint8_t *data, size_t size,
+                       const image_preprocessing::Options &preprocessing,
+                       const image_preprocessing::Output &output,
+                       const Options &options) {
+  return "This build of tfjs-tflite-node can not decode images. Rebuild it "
+      "with 'node-gyp rebuild --image_decoding=true'";
+}
+
+}  // namespace image_decoding
+
+#endif  // TFLITE_NODE_IMAGE_DECODING
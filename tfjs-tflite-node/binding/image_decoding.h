@@ -0,0 +1,58 @@
+/**
+ * @license
+ * Copyright 2022 Google LLC. All Rights Reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * =============================================================================
+ */
+
+#ifndef TFJS_TFLITE_NODE_IMAGE_DECODING_H_
+#define TFJS_TFLITE_NODE_IMAGE_DECODING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "image_preprocessing.h"
+
+namespace image_decoding {
+
+/**
+ * True if the binding was built with JPEG and PNG decoding, which needs
+ * libjpeg (or libjpeg-turbo) and libpng. See 'image_decoding' in binding.gyp.
+ */
+bool isSupported();
+
+struct Options {
+  // Let libjpeg downscale JPEGs by 1/2, 1/4 or 1/8 while decoding, as long as
+  // the result is still at least as large as the output. This skips most of
+  // the decoding work for large images, at a small cost in quality.
+  bool dctScaling = false;
+  // Images with more pixels than this are rejected as soon as their header
+  // has been read, before any pixel memory is allocated.
+  uint64_t maxPixels = 1ull << 26;
+};
+
+/**
+ * Decode a JPEG or PNG image and write it into 'output' with
+ * image_preprocessing::preprocess(), resized to the output's size and
+ * normalized with the mean and std of 'preprocessing'. Its pixel format is
+ * ignored. Returns an error message, or an empty string on success.
+ */
+std::string decodeInto(const uint8_t *data, size_t size,
+                       const image_preprocessing::Options &preprocessing,
+                       const image_preprocessing::Output &output,
+                       const Options &options);
+
+}  // namespace image_decoding
+
+#endif  // TFJS_TFLITE_NODE_IMAGE_DECODING_H_
@@ -0,0 +1,323 @@
+/**
+ * @license
+ * Copyright 2022 Google LLC. All Rights Reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * =============================================================================
+ */
+
+#include "image_preprocessing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TFJS_PREPROCESSING_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define TFJS_PREPROCESSING_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace image_preprocessing {
+namespace {
+
+/**
+ * Where a row's RGB values are: pixel x's channel c is at
+ * data[x * stride + offsets[c]].
+ */
+struct RowView {
+  const uint8_t *data;
+  int stride;
+  int offsets[3];
+};
+
+inline uint8_t clampToByte(int value) {
+  return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+/**
+ * Convert one row of a 4:2:0 YUV image to packed RGB.
+ */
+void yuvRowToRgb(const Image &image, PixelFormat format, int y,
+                 uint8_t *rgb) {
+  int width = image.width;
+  int height = image.height;
+  int chromaWidth = (width + 1) / 2;
+  int chromaHeight = (height + 1) / 2;
+  const uint8_t *luma = image.data + static_cast<size_t>(y) * width;
+  const uint8_t *chroma = image.data + static_cast<size_t>(width) * height;
+  const uint8_t *u;
+  const uint8_t *v;
+  int chromaStride;
+  if (format == kI420) {
+    u = chroma + static_cast<size_t>(y / 2) * chromaWidth;
+    v = chroma + static_cast<size_t>(chromaWidth) * chromaHeight
+        + static_cast<size_t>(y / 2) * chromaWidth;
+    chromaStride = 1;
+  } else {
+    const uint8_t *uv = chroma + static_cast<size_t>(y / 2) * chromaWidth * 2;
+    u = format == kNv12 ? uv : uv + 1;
+    v = format == kNv12 ? uv + 1 : uv;
+    chromaStride = 2;
+  }
+
+  // BT.601 limited range, in 16.16 fixed point.
+  for (int x = 0; x < width; x++) {
+    int c = (luma[x] - 16) * 76284;
+    int d = u[(x / 2) * chromaStride] - 128;
+    int e = v[(x / 2) * chromaStride] - 128;
+    rgb[3 * x] = clampToByte((c + 104595 * e + 32768) >> 16);
+    rgb[3 * x + 1] = clampToByte((c - 25625 * d - 53281 * e + 32768) >> 16);
+    rgb[3 * x + 2] = clampToByte((c + 132252 * d + 32768) >> 16);
+  }
+}
+
+/**
+ * Get row 'y' of the image as RGB. Packed formats are read in place, and YUV
+ * rows are converted into 'scratch'.
+ */
+RowView loadRow(const Image &image, PixelFormat format, int y,
+                std::vector<uint8_t> &scratch) {
+  size_t row = static_cast<size_t>(y) * image.width;
+  switch (format) {
+    case kRgb:
+      return {image.data + row * 3, 3, {0, 1, 2}};
+    case kBgr:
+      return {image.data + row * 3, 3, {2, 1, 0}};
+    case kRgba:
+      return {image.data + row * 4, 4, {0, 1, 2}};
+    case kBgra:
+      return {image.data + row * 4, 4, {2, 1, 0}};
+    case kGray:
+      return {image.data + row, 1, {0, 0, 0}};
+    default:
+      scratch.resize(static_cast<size_t>(image.width) * 3);
+      yuvRowToRgb(image, format, y, scratch.data());
+      return {scratch.data(), 3, {0, 1, 2}};
+  }
+}
+
+/**
+ * The two source indices and the weight of the second one for each output
+ * index, with pixel centers aligned like OpenCV's and TF's half_pixel_centers.
+ */
+struct Sampling {
+  std::vector<int> first;
+  std::vector<int> second;
+  std::vector<float> weight;
+
+  Sampling(int start, int sourceSize, int outputSize)
+      : first(outputSize), second(outputSize), weight(outputSize) {
+    float ratio = static_cast<float>(sourceSize) / outputSize;
+    for (int i = 0; i < outputSize; i++) {
+      float position = (i + 0.5f) * ratio - 0.5f;
+      position = std::max(0.0f, std::min(position,
+                                         static_cast<float>(sourceSize - 1)));
+      int index = static_cast<int>(position);
+      first[i] = start + index;
+      second[i] = start + std::min(index + 1, sourceSize - 1);
+      weight[i] = position - index;
+    }
+  }
+};
+
+/**
+ * Resize one source row horizontally into 'out', which holds 'channels'
+ * values per output pixel.
+ */
+void resizeRow(const RowView &row, const Sampling &columns, int channels,
+               float *out) {
+  size_t width = columns.first.size();
+  for (size_t x = 0; x < width; x++) {
+    const uint8_t *a = row.data + columns.first[x] * row.stride;
+    const uint8_t *b = row.data + columns.second[x] * row.stride;
+    float w = columns.weight[x];
+    float rgb[3];
+    for (int c = 0; c < 3; c++) {
+      float first = a[row.offsets[c]];
+      rgb[c] = first + (b[row.offsets[c]] - first) * w;
+    }
+    if (channels == 3) {
+      out[3 * x] = rgb[0];
+      out[3 * x + 1] = rgb[1];
+      out[3 * x + 2] = rgb[2];
+    } else {
+      out[x] = 0.299f * rgb[0] + 0.587f * rgb[1] + 0.114f * rgb[2];
+    }
+  }
+}
+
+void blendRowsScalar(const float *top, const float *bottom, float w,
+                     const float *multiplier, const float *offset, float *out,
+                     size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    float value = top[i] + (bottom[i] - top[i]) * w;
+    out[i] = value * multiplier[i] + offset[i];
+  }
+}
+
+/**
+ * Interpolate between two horizontally resized rows with weight 'w' and
+ * normalize the result as value * multiplier + offset. SSE2 and NEON are part
+ * of x86-64 and arm64, so the vector paths need no runtime check.
+ */
+void blendRows(const float *top, const float *bottom, float w,
+               const float *multiplier, const float *offset, float *out,
+               size_t count) {
+  size_t i = 0;
+#if defined(TFJS_PREPROCESSING_SSE2)
+  __m128 weight = _mm_set1_ps(w);
+  for (; i + 4 <= count; i += 4) {
+    __m128 t = _mm_loadu_ps(top + i);
+    __m128 b = _mm_loadu_ps(bottom + i);
+    __m128 value = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(b, t), weight));
+    _mm_storeu_ps(out + i, _mm_add_ps(
+        _mm_mul_ps(value, _mm_loadu_ps(multiplier + i)),
+        _mm_loadu_ps(offset + i)));
+  }
+#elif defined(TFJS_PREPROCESSING_NEON)
+  float32x4_t weight = vdupq_n_f32(w);
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t t = vld1q_f32(top + i);
+    float32x4_t b = vld1q_f32(bottom + i);
+    // Separate multiplies and adds, which round like the scalar code.
+    float32x4_t value = vaddq_f32(t, vmulq_f32(vsubq_f32(b, t), weight));
+    vst1q_f32(out + i, vaddq_f32(vmulq_f32(value, vld1q_f32(multiplier + i)),
+                                 vld1q_f32(offset + i)));
+  }
+#endif
+  blendRowsScalar(top + i, bottom + i, w, multiplier + i, offset + i, out + i,
+                  count - i);
+}
+
+}  // namespace
+
+bool parsePixelFormat(const std::string &name, PixelFormat *format) {
+  static const struct {
+    const char *name;
+    PixelFormat format;
+  } kFormats[] = {
+    {"rgb", kRgb}, {"rgba", kRgba}, {"bgr", kBgr}, {"bgra", kBgra},
+    {"gray", kGray}, {"i420", kI420}, {"nv12", kNv12}, {"nv21", kNv21},
+  };
+  for (const auto &entry : kFormats) {
+    if (name == entry.name) {
+      *format = entry.format;
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t imageSize(PixelFormat format, int width, int height) {
+  size_t pixels = static_cast<size_t>(width) * height;
+  switch (format) {
+    case kRgb:
+    case kBgr:
+      return pixels * 3;
+    case kRgba:
+    case kBgra:
+      return pixels * 4;
+    case kGray:
+      return pixels;
+    default:
+      return pixels + 2 * static_cast<size_t>((width + 1) / 2)
+          * ((height + 1) / 2);
+  }
+}
+
+std::string preprocess(const Image &image, const Rect &crop,
+                       const Options &options, const Output &output) {
+  if (crop.width <= 0 || crop.height <= 0 || crop.x < 0 || crop.y < 0
+      || crop.x + crop.width > image.width
+      || crop.y + crop.height > image.height) {
+    return "The crop rectangle must lie within the image";
+  }
+  if (output.channels != 1 && output.channels != 3) {
+    return "Expected the input to have 1 or 3 channels but it has "
+        + std::to_string(output.channels);
+  }
+  if (output.type == tensor_conversion::kBool) {
+    return "Images can not be written to bool tensors";
+  }
+
+  const int width = output.width;
+  const int channels = output.channels;
+  const size_t rowLength = static_cast<size_t>(width) * channels;
+  const size_t rowBytes =
+      rowLength * tensor_conversion::elementSize(output.type);
+  Sampling columns(crop.x, crop.width, width);
+  Sampling rows(crop.y, crop.height, output.height);
+
+  // Normalization as a multiply-add per value, done along with the vertical
+  // interpolation by blendRows().
+  std::vector<float> multiplier(rowLength);
+  std::vector<float> offset(rowLength);
+  for (size_t i = 0; i < rowLength; i++) {
+    int c = channels == 3 ? static_cast<int>(i % 3) : 0;
+    multiplier[i] = 1.0f / options.std[c];
+    offset[i] = -options.mean[c] / options.std[c];
+  }
+
+  // Horizontally resized source rows, cached since neighbouring output rows
+  // usually share them.
+  std::vector<float> cached[2] = {std::vector<float>(rowLength),
+                                  std::vector<float>(rowLength)};
+  int cachedRow[2] = {-1, -1};
+  std::vector<uint8_t> scratch;
+  auto resizedRow = [&](int y) -> const float* {
+    for (int slot = 0; slot < 2; slot++) {
+      if (cachedRow[slot] == y) {
+        return cached[slot].data();
+      }
+    }
+    // Replace the row that is not the other one needed for this output row.
+    int slot = cachedRow[0] < cachedRow[1] ? 0 : 1;
+    resizeRow(loadRow(image, options.format, y, scratch), columns, channels,
+              cached[slot].data());
+    cachedRow[slot] = y;
+    return cached[slot].data();
+  };
+
+  std::vector<float> values(rowLength);
+  uint8_t *out = static_cast<uint8_t*>(output.data);
+  for (int y = 0; y < output.height; y++, out += rowBytes) {
+    const float *top = resizedRow(rows.first[y]);
+    const float *bottom = resizedRow(rows.second[y]);
+    blendRows(top, bottom, rows.weight[y], multiplier.data(), offset.data(),
+              values.data(), rowLength);
+
+    switch (output.type) {
+      case tensor_conversion::kFloat32:
+        std::memcpy(out, values.data(), rowBytes);
+        break;
+      case tensor_conversion::kFloat16:
+      case tensor_conversion::kFloat64:
+        tensor_conversion::convertElements(values.data(),
+                                           tensor_conversion::kFloat32, out,
+                                           output.type, rowLength);
+        break;
+      default:
+        // Integer tensors round and clamp instead of wrapping.
+        tensor_conversion::quantizeFloat32(values.data(), out, output.type,
+                                           output.scale, output.zeroPoint,
+                                           rowLength);
+        break;
+    }
+  }
+  return "";
+}
+
+}  // namespace image_preprocessing
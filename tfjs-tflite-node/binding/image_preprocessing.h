@@ -0,0 +1,102 @@
+/**
+ * @license
+ * Copyright 2022 Google LLC. All Rights Reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * =============================================================================
+ */
+
+#ifndef TFJS_TFLITE_NODE_IMAGE_PREPROCESSING_H_
+#define TFJS_TFLITE_NODE_IMAGE_PREPROCESSING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "tensor_conversion.h"
+
+namespace image_preprocessing {
+
+enum PixelFormat {
+  kRgb,
+  kRgba,
+  kBgr,
+  kBgra,
+  kGray,
+  // 8 bit YUV 4:2:0 with BT.601 limited range colors. I420 has separate U
+  // and V planes, NV12 interleaves U and V, and NV21 interleaves V and U.
+  kI420,
+  kNv12,
+  kNv21,
+};
+
+/**
+ * Parse a format name such as "rgba" or "nv21". Returns false if the name is
+ * not known.
+ */
+bool parsePixelFormat(const std::string &name, PixelFormat *format);
+
+/**
+ * The number of bytes an image of the given format and size takes.
+ */
+size_t imageSize(PixelFormat format, int width, int height);
+
+/**
+ * How pixels are turned into tensor values. Each channel is normalized as
+ * (pixel - mean) / std after resizing.
+ */
+struct Options {
+  PixelFormat format = kRgb;
+  float mean[3] = {0, 0, 0};
+  float std[3] = {1, 1, 1};
+};
+
+struct Image {
+  const uint8_t *data;
+  int width;
+  int height;
+};
+
+struct Rect {
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+/**
+ * An NHWC tensor buffer holding a single image. 'channels' is 3 for RGB or 1
+ * for grayscale. Integer types are quantized with 'scale' and 'zeroPoint',
+ * which are 1 and 0 for tensors that are not quantized.
+ */
+struct Output {
+  void *data;
+  tensor_conversion::ElementType type;
+  int height;
+  int width;
+  int channels;
+  float scale;
+  int32_t zeroPoint;
+};
+
+/**
+ * Crop 'image' to 'crop', resize it bilinearly to the output's size,
+ * normalize it and write it into the output, one row at a time and without
+ * intermediate images. Returns an error message, or an empty string on
+ * success.
+ */
+std::string preprocess(const Image &image, const Rect &crop,
+                       const Options &options, const Output &output);
+
+}  // namespace image_preprocessing
+
+#endif  // TFJS_TFLITE_NODE_IMAGE_PREPROCESSING_H_
@@ -17,16 +17,51 @@
 
 #include <cstdint>
 #include <napi.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <vector>
+#include <sys/stat.h>
+#ifdef WIN
+#include <direct.h>
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
 #include "tensorflow/lite/c/c_api.h"
 #include "tensorflow/lite/c/c_api_types.h"
+#include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/delegates/external/external_delegate.h"
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+#include "image_decoding.h"
+#include "image_preprocessing.h"
+#include "postprocessing.h"
+#include "tensor_conversion.h"
+#include "thread_affinity.h"
 
 #define MAX_ERROR_LEN 1000
 
+// From tensorflow/lite/c/c_api_experimental.h, which is not vendored. Every
+// bundled TFLite library exports it.
+extern "C" TFL_CAPI_EXPORT TfLiteStatus
+TfLiteInterpreterModifyGraphWithDelegate(const TfLiteInterpreter *interpreter,
+                                         TfLiteDelegate *delegate);
+
 namespace tfjs_tflite_node {
 
 std::string decodeStatus(TfLiteStatus status) {
@@ -53,531 +88,3894 @@ std::string decodeStatus(TfLiteStatus status) {
   return "Unknown status code";
 }
 
-class TensorInfo : public Napi::ObjectWrap<TensorInfo> {
- public:
-  static Napi::FunctionReference constructor;
-  static Napi::Object Init(Napi::Env env, Napi::Object exports) {
-    Napi::HandleScope scope(env);
-    Napi::Function func = DefineClass(env, "TensorInfo", {
-        InstanceAccessor<&TensorInfo::GetDataType>("dataType"),
-        InstanceAccessor<&TensorInfo::GetShape>("shape"),
-        InstanceAccessor<&TensorInfo::GetId>("id"),
-        InstanceAccessor<&TensorInfo::GetName>("name"),
-        InstanceMethod<&TensorInfo::GetData>("data"),
-      });
+/**
+ * State owned by one Node.js environment: the main thread or a worker thread
+ * that loaded the addon. It is stored as the environment's instance data, so
+ * each environment creates objects from its own class constructors, and the
+ * references are released when that environment shuts down.
+ *
+ * Native state that is not tied to JavaScript, like the ModelRegistry, is
+ * process-wide and safe to use from several environments.
+ */
+struct AddonData {
+  Napi::FunctionReference interpreterConstructor;
+  Napi::FunctionReference tensorInfoConstructor;
+  // Distinguishes this environment's models in the ModelRegistry.
+  const uint64_t id = nextId()++;
+  // The thread running this environment's JavaScript.
+  const std::thread::id thread = std::this_thread::get_id();
+
+  explicit AddonData(Napi::Env env) : env(env) {
+    tasks = Napi::ThreadSafeFunction::New(
+        env, Napi::Function::New(env, [](const Napi::CallbackInfo &) { }),
+        "tfjs_tflite_node:tasks", 0, 1);
+    // Only tasks that are waiting keep the event loop alive. See Hold().
+    tasks.Unref(env);
+  }
 
-    // Create a persistent reference to the class constructor. This lets us
-    // instantiate TensorInfos in the interpreter.
-    constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct();
+  // Cancels this environment's inferences waiting for the ThreadBudget.
+  ~AddonData();
 
-    return exports;
+  static AddonData *Get(Napi::Env env) {
+    return env.GetInstanceData<AddonData>();
   }
 
-  TensorInfo(const Napi::CallbackInfo& info)
-      : Napi::ObjectWrap<TensorInfo>(info) { }
+  /**
+   * Run 'task' on this environment's JavaScript thread: right away if called
+   * there, otherwise once that thread gets to it. Returns false, without
+   * running it, if the environment is shutting down.
+   */
+  bool Run(std::function<void()> task) {
+    if (std::this_thread::get_id() == thread) {
+      task();
+      return true;
+    }
+    auto *posted = new std::function<void()>(std::move(task));
+    napi_status status = tasks.NonBlockingCall(
+        posted, [](Napi::Env, Napi::Function, std::function<void()> *task) {
+          (*task)();
+          delete task;
+        });
+    if (status != napi_ok) {
+      delete posted;
+      return false;
+    }
+    return true;
+  }
 
-  ~TensorInfo() {
-    dataArray.Unref();
+  /**
+   * Keep the event loop alive until a matching Unhold(), while something of
+   * this environment waits for another thread to Run() it. Only called on the
+   * JavaScript thread.
+   */
+  void Hold() {
+    if (holds++ == 0) {
+      tasks.Ref(env);
+    }
+  }
+
+  void Unhold() {
+    if (--holds == 0) {
+      tasks.Unref(env);
+    }
+  }
+
+  /**
+   * Release a reference owned by this environment from any thread. N-API
+   * references may only be deleted on the JavaScript thread, so those dropped
+   * elsewhere are kept until ReleasePending() runs there.
+   */
+  void Release(Napi::Reference<Napi::Uint8Array> ref) {
+    if (std::this_thread::get_id() == thread) {
+      // 'ref' is deleted on return.
+      return;
+    }
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    pending.push_back(std::move(ref));
+  }
+
+  /** Delete the references released off the JavaScript thread. */
+  void ReleasePending() {
+    std::vector<Napi::Reference<Napi::Uint8Array>> released;
+    {
+      std::lock_guard<std::mutex> lock(pendingMutex);
+      released.swap(pending);
+    }
+    // Deleted outside the lock, as 'released' goes out of scope.
   }
 
  private:
-  friend class Interpreter;
-  const TfLiteTensor *tensor = nullptr;
-  void *localData = nullptr;
-  int id = -1;
-  Napi::Reference<Napi::TypedArray> dataArray;
+  static std::atomic<uint64_t> &nextId() {
+    static std::atomic<uint64_t> n(0);
+    return n;
+  }
 
-  void throwIfError(Napi::Env &env, std::string message, TfLiteStatus status) {
-    if (status != kTfLiteOk) {
-      throw Napi::Error::New(env, message + ": " + decodeStatus(status));
+  Napi::Env env;
+  Napi::ThreadSafeFunction tasks;
+  int holds = 0;
+  std::mutex pendingMutex;
+  std::vector<Napi::Reference<Napi::Uint8Array>> pending;
+};
+
+/**
+ * An immutable TfLiteModel along with the memory it was created from. Shared
+ * by every interpreter created from the same model bytes.
+ */
+struct SharedModel {
+  TfLiteModel *model = nullptr;
+  // The model bytes. Empty for models memory-mapped from a file, whose memory
+  // is owned by the TfLiteModel, and for models built over JavaScript memory.
+  std::vector<uint8_t> data;
+  // The memory the model was built from, either 'data' or JavaScript memory.
+  // Null for memory-mapped models.
+  const uint8_t *bytes = nullptr;
+  size_t size = 0;
+  // For models built in place over a Uint8Array, such as a view of a
+  // SharedArrayBuffer, the reference that keeps its memory alive and the
+  // environment that owns it. These models are only shared within that
+  // environment.
+  Napi::Reference<Napi::Uint8Array> external;
+  AddonData *owner = nullptr;
+  // Key of this model in the ModelRegistry, or empty if it is not registered.
+  std::string key;
+  // The resolved path of a model memory-mapped from a file.
+  std::string path;
+  // Identifies the model's contents across processes. Used to key serialized
+  // delegate data. Set by the ModelRegistry for models loaded from memory,
+  // and by DelegateCache::ModelKey() for files.
+  std::string contentKey;
+
+  ~SharedModel() {
+    TfLiteModelDelete(model);
+    // The last reference to the model may be dropped off the JavaScript
+    // thread, which must delete the reference to its memory.
+    if (owner) {
+      owner->Release(std::move(external));
     }
   }
+};
 
+/**
+ * A process-wide, content-hashed cache of SharedModels.
+ *
+ * Entries are held weakly. A model is freed as soon as the last interpreter
+ * using it is deleted, at which point its entry is removed.
+ */
+class ModelRegistry {
+ public:
   /**
-   * Copy the tensor's local data to the TFLite tensor.
+   * Get the SharedModel for the given model bytes, creating it if no live
+   * model with the same contents exists. Returns nullptr if TFLite fails to
+   * parse the model.
    *
-   * This is necessary because we can't base the TypedArray off of the TFLite
-   * tensor's void* data pointer. If we do, we see the following error in node
-   * versions 13 through 16:
-   * # Fatal error in , line 0
-   * # Check failed: result.second.
+   * If 'numaNode' is not -1, the model is only shared by interpreters placed
+   * on the same node, and the caller copies it from a thread using that
+   * node's memory.
    */
-  void copyToTflite(Napi::Env &env) {
-    throwIfError(env, "Failed to copy tensor data to TFLite",
-                 TfLiteTensorCopyFromBuffer((TfLiteTensor*) tensor, localData,
-                                            TfLiteTensorByteSize(tensor)));
+  static std::shared_ptr<SharedModel> GetOrCreate(const uint8_t *data,
+                                                  size_t size,
+                                                  int numaNode = -1) {
+    std::string contentKey = HashKey(data, size);
+    std::string key = contentKey;
+    if (numaNode >= 0) {
+      key += ":node" + std::to_string(numaNode);
+    }
+    bool collision = false;
+    std::shared_ptr<SharedModel> existing = find(key, data, size, &collision);
+    if (existing) {
+      return existing;
+    }
+
+    std::shared_ptr<SharedModel> model(new SharedModel(), &deleteModel);
+    model->data = std::vector<uint8_t>(data, data + size);
+    model->bytes = model->data.data();
+    model->size = model->data.size();
+    model->model = TfLiteModelCreate(model->bytes, model->size);
+    if (!model->model) {
+      return nullptr;
+    }
+    model->contentKey = contentKey;
+
+    // On a hash collision with different contents, don't replace the
+    // existing entry. The new model is simply not shared.
+    if (!collision) {
+      insert(key, model);
+    }
+    return model;
   }
 
   /**
-   * Copy the TFLite tensor to local data.
+   * Get a SharedModel with the contents of 'array', building it in place over
+   * the array's memory if no live model has the same contents. A copy loaded
+   * by any environment is preferred, then a model built over the same bytes
+   * in the array's own environment. Must be called on that environment's
+   * JavaScript thread. Returns nullptr if TFLite fails to parse the model.
    */
-  void copyFromTflite(Napi::Env &env) {
-    throwIfError(env, "Failed to copy tensor data from TFLite",
-                 TfLiteTensorCopyToBuffer(tensor, localData,
-                                          TfLiteTensorByteSize(tensor)));
+  static std::shared_ptr<SharedModel> GetOrCreateInPlace(
+      Napi::Uint8Array array) {
+    const uint8_t *data = array.Data();
+    size_t size = array.ByteLength();
+    AddonData *owner = AddonData::Get(array.Env());
+    std::string contentKey = HashKey(data, size);
+    std::string key = contentKey + ":env" + std::to_string(owner->id);
+    // Only a collision on this environment's key keeps the model unshared.
+    bool copy_collision = false;
+    bool collision = false;
+    std::shared_ptr<SharedModel> existing =
+        find(contentKey, data, size, &copy_collision);
+    if (!existing) {
+      existing = find(key, data, size, &collision);
+    }
+    if (existing) {
+      return existing;
+    }
+
+    std::shared_ptr<SharedModel> model(new SharedModel(), &deleteModel);
+    model->bytes = data;
+    model->size = size;
+    model->model = TfLiteModelCreate(data, size);
+    if (!model->model) {
+      return nullptr;
+    }
+    model->external = Napi::Persistent(array);
+    model->owner = owner;
+    model->contentKey = contentKey;
+    if (!collision) {
+      insert(key, model);
+    }
+    return model;
   }
 
-  void setTensor(Napi::Env env, const TfLiteTensor *t, int i) {
-    tensor = t;
-    id = i;
+  /**
+   * Get the SharedModel for the model file at 'path', memory-mapping it with
+   * TfLiteModelCreateFromFile if it is not already loaded. Weights are then
+   * paged in lazily and shared through the page cache with other processes.
+   * Returns nullptr if the file can't be read or parsed.
+   */
+  static std::shared_ptr<SharedModel> GetOrCreateFromFile(
+      const std::string &path) {
+    std::string resolved;
+    std::string key = fileKey(path, &resolved);
+    if (key.empty()) {
+      return nullptr;
+    }
+    std::shared_ptr<SharedModel> existing;
+    {
+      std::lock_guard<std::mutex> lock(mutex());
+      auto it = entries().find(key);
+      if (it != entries().end()) {
+        existing = it->second.lock();
+      }
+    }
+    if (existing) {
+      return existing;
+    }
 
-    TfLiteType tensorType = TfLiteTensorType(tensor);
-    size_t byteSize = TfLiteTensorByteSize(tensor);
-    auto buffer = Napi::ArrayBuffer::New(env, byteSize);
-    localData = buffer.Data();
+    std::shared_ptr<SharedModel> model(new SharedModel(), &deleteModel);
+    model->model = TfLiteModelCreateFromFile(path.c_str());
+    if (!model->model) {
+      return nullptr;
+    }
+    model->path = resolved;
+    insert(key, model);
+    return model;
+  }
 
-    Napi::TypedArray typedArray;
-    switch (tensorType) {
-    case kTfLiteNoType:
-      typedArray = Napi::Uint8Array::New(env, getLength(), buffer, 0);
-      break;
-    case kTfLiteFloat32:
-      typedArray = Napi::Float32Array::New(env, getLength(), buffer, 0);
-      break;
-    case kTfLiteInt32:
-      typedArray = Napi::Int32Array::New(env, getLength(), buffer, 0);
-      break;
-    case kTfLiteUInt8:
-      typedArray = Napi::Uint8Array::New(env, getLength(), buffer, 0);
-      break;
-    case kTfLiteInt64:
-      typedArray = Napi::BigInt64Array::New(env, getLength(), buffer, 0);
-      break;
-    case kTfLiteString:
-      throw Napi::Error::New(env, "'kTfLiteString' is not yet supported");
-      break;
-    case kTfLiteBool:
-      typedArray = Napi::Uint8Array::New(env, getLength(), buffer, 0);
-      break;
-    case kTfLiteInt16:
-      typedArray = Napi::Int16Array::New(env, getLength(), buffer, 0);
-      break;
-    case kTfLiteComplex64:
-      throw Napi::Error::New(env, "'kTfLiteComplex64' is not yet supported");
-      break;
-    case kTfLiteInt8:
-      typedArray = Napi::Int8Array::New(env, getLength(), buffer, 0);
-      break;
-    case kTfLiteFloat16:
-      throw Napi::Error::New(env, "'kTfLiteFloat16' is not yet supported");
-      break;
-    case kTfLiteFloat64:
-      typedArray = Napi::Float64Array::New(env, getLength(), buffer, 0);
-      break;
-    case kTfLiteComplex128:
-      throw Napi::Error::New(env, "'kTfLiteComplex128' is not yet supported");
-      break;
-    case kTfLiteUInt64:
-      typedArray = Napi::BigUint64Array::New(env, getLength(), buffer, 0);
-      break;
-    case kTfLiteResource:
-      throw Napi::Error::New(env, "'kTfLiteResource' is not yet supported");
-      break;
-    case kTfLiteVariant:
-      throw Napi::Error::New(env, "'kTfLiteVariant' is not yet supported");
-      break;
-    case kTfLiteUInt32:
-      typedArray = Napi::Uint32Array::New(env, getLength(), buffer, 0);
-      break;
+  /**
+   * A 64-bit FNV-1a style hash of the model, mixed a word at a time so that
+   * hashing a large model stays much cheaper than copying it.
+   */
+  static std::string HashKey(const uint8_t *data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    const uint64_t prime = 1099511628211ULL;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+      uint64_t word;
+      std::memcpy(&word, data + i, sizeof(word));
+      hash = (hash ^ word) * prime;
+      hash ^= hash >> 32;
     }
-    // Start reference count at 1 since the Tensor object (this object) has a
-    // reference to the data array. This prevents JavaScript from GC-ing it.
-    dataArray = Napi::Reference<Napi::TypedArray>::New(typedArray, 1);
+    for (; i < size; i++) {
+      hash = (hash ^ data[i]) * prime;
+    }
+
+    std::stringstream key;
+    key << "bytes:" << std::hex << hash << ":" << std::dec << size;
+    return key.str();
   }
 
-  Napi::Value GetId(const Napi::CallbackInfo &info) {
-    Napi::Env env = info.Env();
-    return Napi::Number::New(env, id);
+ private:
+  static std::mutex &mutex() {
+    static std::mutex m;
+    return m;
   }
 
-  Napi::Value GetName(const Napi::CallbackInfo &info) {
-    Napi::Env env = info.Env();
-    if (tensor != nullptr) {
-      std::string name(TfLiteTensorName(tensor));
-      return Napi::String::New(env, name);
-    }
-    return Napi::String::New(env, "unknown tensor");
+  static std::map<std::string, std::weak_ptr<SharedModel>> &entries() {
+    static std::map<std::string, std::weak_ptr<SharedModel>> e;
+    return e;
   }
 
-  Napi::Value GetDataType(const Napi::CallbackInfo &info) {
-    Napi::Env env = info.Env();
-    TfLiteType tensorType = TfLiteTensorType(tensor);
-    switch (tensorType) {
-      case kTfLiteNoType:
-        return Napi::String::New(env, "kTfLiteNoType");
-      case kTfLiteFloat32:
-        return Napi::String::New(env, "float32");
-      case kTfLiteInt32:
-        return Napi::String::New(env, "int32");
-      case kTfLiteUInt8:
-        return Napi::String::New(env, "uint8");
-      case kTfLiteInt64:
-        return Napi::String::New(env, "kTfLiteInt64");
-      case kTfLiteString:
-        return Napi::String::New(env, "kTfLiteString");
-      case kTfLiteBool:
-        return Napi::String::New(env, "bool");
-      case kTfLiteInt16:
-        return Napi::String::New(env, "int16");
-      case kTfLiteComplex64:
-        return Napi::String::New(env, "kTfLiteComplex64");
-      case kTfLiteInt8:
-        return Napi::String::New(env, "int8");
-      case kTfLiteFloat16:
-        return Napi::String::New(env, "kTfLiteFloat16");
-      case kTfLiteFloat64:
-        return Napi::String::New(env, "float64");
-      case kTfLiteComplex128:
-        return Napi::String::New(env, "kTfLiteComplex128");
-      case kTfLiteUInt64:
-        return Napi::String::New(env, "kTfLiteUInt64");
-      case kTfLiteResource:
-        return Napi::String::New(env, "kTfLiteResource");
-      case kTfLiteVariant:
-        return Napi::String::New(env, "kTfLiteVariant");
-      case kTfLiteUInt32:
-        return Napi::String::New(env, "uint32");
-      default:
-        return Napi::String::New(env, "Unknown data type");
+  /**
+   * Find the live model registered under 'key' if it was built from the same
+   * bytes. Sets 'collision' if a model with different contents holds the key.
+   */
+  static std::shared_ptr<SharedModel> find(const std::string &key,
+                                           const uint8_t *data, size_t size,
+                                           bool *collision) {
+    std::shared_ptr<SharedModel> existing;
+    {
+      std::lock_guard<std::mutex> lock(mutex());
+      auto it = entries().find(key);
+      if (it != entries().end()) {
+        existing = it->second.lock();
+      }
+    }
+    // Compare the bytes outside the lock. 'existing' may be the last
+    // reference to the model, and its deleter takes the lock.
+    if (existing && existing->size == size &&
+        std::memcmp(existing->bytes, data, size) == 0) {
+      return existing;
     }
+    *collision = existing != nullptr;
+    return nullptr;
   }
 
-  Napi::Value GetShape(const Napi::CallbackInfo &info) {
-    Napi::Env env = info.Env();
-    int numDims = TfLiteTensorNumDims(tensor);
+  static void insert(const std::string &key,
+                     const std::shared_ptr<SharedModel> &model) {
+    std::lock_guard<std::mutex> lock(mutex());
+    auto &entry = entries()[key];
+    if (entry.expired()) {
+      entry = model;
+      model->key = key;
+    }
+  }
 
-    std::stringstream shape;
-    for (int i = 0; i < numDims; i++) {
-      if (i != 0) {
-        shape << ",";
+  static void deleteModel(SharedModel *model) {
+    if (!model->key.empty()) {
+      std::lock_guard<std::mutex> lock(mutex());
+      auto it = entries().find(model->key);
+      // The entry may already have been replaced by a new model with the same
+      // contents, created after this one's last reference was dropped.
+      if (it != entries().end() && it->second.expired()) {
+        entries().erase(it);
       }
-      shape << TfLiteTensorDim(tensor, i);
     }
-
-    return Napi::String::New(env, shape.str());
+    delete model;
   }
 
-  size_t getLength() {
-    TfLiteType tensorType = TfLiteTensorType(tensor);
-    size_t byteSize = TfLiteTensorByteSize(tensor);
-    switch (tensorType) {
-      case kTfLiteNoType:
-        return byteSize;
-      case kTfLiteFloat32:
-        return byteSize / 4;
-      case kTfLiteInt32:
-        return byteSize / 4;
-      case kTfLiteUInt8:
-        return byteSize;
-      case kTfLiteInt64:
-        return byteSize / 8;
-      case kTfLiteString:
-        return byteSize;
-      case kTfLiteBool:
-        return byteSize;
-      case kTfLiteInt16:
-        return byteSize / 2;
-      case kTfLiteComplex64:
-        return byteSize / 8;
-      case kTfLiteInt8:
-        return byteSize;
-      case kTfLiteFloat16:
-        return byteSize / 2;
-      case kTfLiteFloat64:
-        return byteSize / 8;
-      case kTfLiteComplex128:
-        return byteSize / 16;
-      case kTfLiteUInt64:
-        return byteSize / 8;
-      case kTfLiteResource:
-        return byteSize;
-      case kTfLiteVariant:
-        return byteSize;
-      case kTfLiteUInt32:
-        return byteSize / 4;
-      default:
-        return byteSize;
+  /**
+   * Key a model file by its canonical path, size and modification time, so
+   * that a file replaced on disk is loaded again, and set 'resolved' to the
+   * canonical path. Returns an empty string if the file does not exist.
+   */
+  static std::string fileKey(const std::string &path, std::string *resolved) {
+#ifdef WIN
+    char canonical[_MAX_PATH];
+    if (_fullpath(canonical, path.c_str(), _MAX_PATH) == nullptr) {
+      return "";
+    }
+#else
+    char canonical[PATH_MAX];
+    if (realpath(path.c_str(), canonical) == nullptr) {
+      return "";
     }
+#endif
+    struct stat file_stat;
+    if (stat(canonical, &file_stat) != 0) {
+      return "";
+    }
+
+    *resolved = canonical;
+    std::stringstream key;
+    key << "file:" << canonical << ":" << file_stat.st_size << ":"
+        << file_stat.st_mtime;
+    return key.str();
   }
+};
+
+/**
+ * Where delegates that support serialization, like the GPU delegate, persist
+ * their compiled graphs between runs.
+ *
+ * Each delegate is given a model token that hashes the model's contents, the
+ * delegate library and its options, so a cache entry is only reused for the
+ * same compilation. Hits and misses are counted process-wide, once per token:
+ * later interpreters of the same model in the process, like those of a pool,
+ * reuse what the first one compiled or loaded.
+ */
+class DelegateCache {
+ public:
+  /** A delegate's cache entry, looked up before it compiles the model. */
+  struct Entry {
+    std::string dir;
+    std::string token;
+    // Whether the directory already held serialized data for the token.
+    bool found;
+  };
+
+  /**
+   * Identifies the contents of 'model' across processes. Models memory-mapped
+   * from a file are read and hashed the first time this is called for them.
+   * Returns an empty string if the file can't be read.
+   */
+  static std::string ModelKey(SharedModel &model) {
+    std::lock_guard<std::mutex> lock(mutex());
+    if (model.contentKey.empty() && !model.path.empty()) {
+      std::vector<uint8_t> bytes;
+      if (readFile(model.path, &bytes)) {
+        model.contentKey = ModelRegistry::HashKey(bytes.data(), bytes.size());
+      }
+    }
+    return model.contentKey;
+  }
+
+  /**
+   * The token naming this compilation's files in the cache directory.
+   */
+  static std::string Token(
+      const std::string &modelKey, const std::string &delegatePath,
+      const std::vector<std::pair<std::string, std::string>> &options) {
+    std::stringstream description;
+    description << modelKey << '\n' << delegatePath;
+    for (const auto &option : options) {
+      description << '\n' << option.first << '=' << option.second;
+    }
+    std::string key = description.str();
+    // "bytes:<hash>:<size>" becomes "tfjs_<hash>_<size>", a safe file name
+    // prefix.
+    std::string token = "tfjs" + ModelRegistry::HashKey(
+        reinterpret_cast<const uint8_t*>(key.data()), key.size()).substr(5);
+    std::replace(token.begin(), token.end(), ':', '_');
+    return token;
+  }
+
+  /**
+   * Create 'dir' if it does not exist, then look up the files for 'token' in
+   * it. Returns an error message if the directory can't be created.
+   */
+  static std::string Find(const std::string &dir, const std::string &token,
+                          Entry *entry) {
+#ifdef WIN
+    int status = _mkdir(dir.c_str());
+#else
+    int status = mkdir(dir.c_str(), 0755);
+#endif
+    if (status != 0 && errno != EEXIST) {
+      return "Failed to create the delegate cache directory '" + dir +
+             "': " + std::strerror(errno);
+    }
+    struct stat dir_stat;
+    if (stat(dir.c_str(), &dir_stat) != 0 ||
+        (dir_stat.st_mode & S_IFMT) != S_IFDIR) {
+      return "The delegate cache directory '" + dir + "' is not a directory";
+    }
+    entry->dir = dir;
+    entry->token = token;
+    entry->found = hasEntry(dir, token);
+    return "";
+  }
+
+  /**
+   * Count 'entry' as a hit or a miss once its delegate has been applied,
+   * unless an earlier interpreter in the process already counted its token.
+   */
+  static void Count(const Entry &entry) {
+    {
+      std::lock_guard<std::mutex> lock(mutex());
+      if (!counted().insert(entry.dir + "\n" + entry.token).second) {
+        return;
+      }
+    }
+    if (entry.found) {
+      hits()++;
+    } else {
+      misses()++;
+    }
+  }
+
+  static uint64_t Hits() {
+    return hits();
+  }
+
+  static uint64_t Misses() {
+    return misses();
+  }
+
+ private:
+  static std::mutex &mutex() {
+    static std::mutex m;
+    return m;
+  }
+
+  static std::set<std::string> &counted() {
+    static std::set<std::string> c;
+    return c;
+  }
+
+  static std::atomic<uint64_t> &hits() {
+    static std::atomic<uint64_t> h(0);
+    return h;
+  }
+
+  static std::atomic<uint64_t> &misses() {
+    static std::atomic<uint64_t> m(0);
+    return m;
+  }
+
+  static bool readFile(const std::string &path, std::vector<uint8_t> *bytes) {
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+      return false;
+    }
+    uint8_t buffer[1 << 16];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      bytes->insert(bytes->end(), buffer, buffer + read);
+    }
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    return ok;
+  }
+
+  /**
+   * Whether 'dir' holds a non-empty file whose name starts with 'prefix'.
+   * Delegates name their serialized data after the model token.
+   */
+  static bool hasEntry(const std::string &dir, const std::string &prefix) {
+#ifdef WIN
+    _finddata_t file;
+    intptr_t find = _findfirst((dir + "\\" + prefix + "*").c_str(), &file);
+    if (find == -1) {
+      return false;
+    }
+    bool found = false;
+    do {
+      found = !(file.attrib & _A_SUBDIR) && file.size > 0;
+    } while (!found && _findnext(find, &file) == 0);
+    _findclose(find);
+    return found;
+#else
+    DIR *entries = opendir(dir.c_str());
+    if (!entries) {
+      return false;
+    }
+    bool found = false;
+    while (dirent *entry = readdir(entries)) {
+      if (std::strncmp(entry->d_name, prefix.c_str(), prefix.size()) != 0) {
+        continue;
+      }
+      struct stat file_stat;
+      std::string file = dir + "/" + entry->d_name;
+      if (stat(file.c_str(), &file_stat) == 0 &&
+          (file_stat.st_mode & S_IFMT) == S_IFREG && file_stat.st_size > 0) {
+        found = true;
+        break;
+      }
+    }
+    closedir(entries);
+    return found;
+#endif
+  }
+};
+
+/**
+ * A process-wide cap on the threads running inference at once.
+ *
+ * TFLite fixes an interpreter's thread count when it is created, and the C
+ * API can't change it per invoke, so running interpreters can't be given
+ * fewer threads. Instead, interpreters are created with at most 'limit'
+ * threads, and the budget acts as an admission gate: an asynchronous
+ * inference is only queued on the libuv thread pool once its interpreter's
+ * threads fit in what the running ones leave. Waiting inferences hold no
+ * thread, and are admitted in arrival order so interpreters with many
+ * threads are not starved by those with few.
+ */
+class ThreadBudget {
+ public:
+  /**
+   * Holds 'threads' of the budget until it is destroyed. They are taken at
+   * once, even past the limit, since waiting would block the JavaScript
+   * thread. Used by synchronous inference.
+   */
+  class Scope {
+   public:
+    explicit Scope(int threads) : threads(threads) {
+      State &s = state();
+      std::lock_guard<std::mutex> lock(s.mutex);
+      s.running += threads;
+    }
+
+    ~Scope() {
+      Release(threads);
+    }
+
+   private:
+    int threads;
+  };
+
+  /**
+   * Holds the threads ThreadBudget::Queue() took for a worker, and gives them
+   * back when released or destroyed, whichever comes first, so that no path
+   * out of the worker keeps them.
+   */
+  class Admitted {
+   public:
+    explicit Admitted(int threads) : threads(threads) { }
+
+    ~Admitted() {
+      Release();
+    }
+
+    void Release() {
+      if (threads > 0) {
+        ThreadBudget::Release(threads);
+        threads = 0;
+      }
+    }
+
+   private:
+    int threads;
+  };
+
+  struct Stats {
+    int limit;
+    // Threads of the invokes running now, and the number of invokes waiting.
+    int running;
+    int waiting;
+    // Live interpreters and the threads they were created with.
+    int interpreters;
+    int threads;
+  };
+
+  /**
+   * Queue 'worker' on the libuv thread pool once 'threads' of the budget are
+   * free. The worker holds them in an Admitted until its invoke finishes.
+   * Called on the JavaScript thread of 'env'.
+   */
+  static void Queue(Napi::Env env, Napi::AsyncWorker *worker, int threads) {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.waiting.empty() && fits(s, threads)) {
+      s.running += threads;
+      worker->Queue();
+      return;
+    }
+    AddonData *owner = AddonData::Get(env);
+    owner->Hold();
+    s.waiting.push_back({threads, owner, [owner, worker]() {
+      return owner->Run([owner, worker]() {
+        owner->Unhold();
+        worker->Queue();
+      });
+    }});
+  }
+
+  /**
+   * Give back 'threads' and admit the waiting inferences that now fit. Safe
+   * to call from any thread.
+   */
+  static void Release(int threads) {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.running -= threads;
+    admit(s);
+  }
+
+  /**
+   * Forget the inferences of 'owner' that are still waiting, when its
+   * environment shuts down.
+   */
+  static void Cancel(AddonData *owner) {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.waiting.erase(
+        std::remove_if(s.waiting.begin(), s.waiting.end(),
+                       [owner](const Waiter &w) { return w.owner == owner; }),
+        s.waiting.end());
+    admit(s);
+  }
+
+  /**
+   * Set the most threads to run at once. Zero removes the limit.
+   */
+  static void SetLimit(int limit) {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.limit = std::max(limit, 0);
+    admit(s);
+  }
+
+  /**
+   * The number of threads to create an interpreter with when it asks for
+   * 'threads'.
+   */
+  static int Clamp(int threads) {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.limit > 0 && threads > s.limit ? s.limit : threads;
+  }
+
+  static void Register(int threads) {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.interpreters++;
+    s.allocated += threads;
+  }
+
+  static void Unregister(int threads) {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.interpreters--;
+    s.allocated -= threads;
+  }
+
+  static Stats GetStats() {
+    State &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return {s.limit, s.running, static_cast<int>(s.waiting.size()),
+            s.interpreters, s.allocated};
+  }
+
+ private:
+  struct Waiter {
+    int threads;
+    AddonData *owner;
+    // Starts the inference on its environment's JavaScript thread. Returns
+    // false if that environment is shutting down.
+    std::function<bool()> start;
+  };
+
+  struct State {
+    std::mutex mutex;
+    int limit = 0;
+    int running = 0;
+    std::deque<Waiter> waiting;
+    int interpreters = 0;
+    int allocated = 0;
+  };
+
+  static State &state() {
+    static State s;
+    return s;
+  }
+
+  // An invoke that needs more than the limit, from an interpreter created
+  // before it was lowered, runs once nothing else is running.
+  static bool fits(const State &s, int threads) {
+    return s.limit == 0 || s.running == 0 || s.running + threads <= s.limit;
+  }
+
+  static void admit(State &s) {
+    while (!s.waiting.empty() && fits(s, s.waiting.front().threads)) {
+      Waiter waiter = std::move(s.waiting.front());
+      s.waiting.pop_front();
+      s.running += waiter.threads;
+      if (!waiter.start()) {
+        s.running -= waiter.threads;
+      }
+    }
+  }
+};
+
+AddonData::~AddonData() {
+  ThreadBudget::Cancel(this);
+}
+
+/**
+ * Owns a TfLiteInterpreter and everything it references: the shared model,
+ * the interpreter options, and the error stream TFLite reports to.
+ *
+ * It is reference counted so that ArrayBuffers created over the interpreter's
+ * tensor arena (see 'zeroCopy') keep the arena alive after the Interpreter
+ * object that created them has been garbage collected.
+ */
+struct InterpreterHandle {
+  TfLiteInterpreter *interpreter = nullptr;
+  std::shared_ptr<SharedModel> model;
+  TfLiteInterpreterOptions *options = nullptr;
+  // Delegates, in the order they are applied, with the functions that delete
+  // them.
+  std::vector<std::pair<TfLiteDelegate*, void(*)(TfLiteDelegate*)>> delegates;
+  std::stringstream errorStream;
+  // The threads each invoke takes from the ThreadBudget.
+  int threads = 0;
+  // CPUs and NUMA node the interpreter runs on.
+  thread_affinity::Placement placement;
+
+  /**
+   * Run the interpreter. Callers hold its threads of the ThreadBudget.
+   */
+  TfLiteStatus invoke() {
+    thread_affinity::Scope affinity(placement);
+    return TfLiteInterpreterInvoke(interpreter);
+  }
+
+  /**
+   * Allocate tensors from a thread on the interpreter's placement, so the
+   * arena and the default delegate's threads land there too.
+   */
+  TfLiteStatus allocate() {
+    thread_affinity::Scope affinity(placement);
+    return TfLiteInterpreterAllocateTensors(interpreter);
+  }
+
+  ~InterpreterHandle() {
+    if (threads > 0) {
+      ThreadBudget::Unregister(threads);
+    }
+    // Delete the interpreter before releasing the delegates and model it
+    // references.
+    TfLiteInterpreterDelete(interpreter);
+    for (const auto &delegate : delegates) {
+      delegate.second(delegate.first);
+    }
+    TfLiteInterpreterOptionsDelete(options);
+  }
+};
+
+/**
+ * Tracks the addresses of TFLite memory currently wrapped by external
+ * ArrayBuffers.
+ *
+ * Node versions 13 through 16 crash with "Check failed: result.second" when
+ * two live ArrayBuffers share the same backing store address. TFLite can hand
+ * out the same address twice (aliased tensors, or an arena that was
+ * reallocated while an old ArrayBuffer over it is still waiting to be
+ * collected), so every address is checked here before it is wrapped.
+ */
+class ExternalBufferRegistry {
+ public:
+  static bool TryAcquire(void *data) {
+    std::lock_guard<std::mutex> lock(mutex());
+    return addresses().insert(data).second;
+  }
+
+  static void Release(void *data) {
+    std::lock_guard<std::mutex> lock(mutex());
+    addresses().erase(data);
+  }
+
+ private:
+  static std::mutex &mutex() {
+    static std::mutex m;
+    return m;
+  }
+
+  static std::set<void*> &addresses() {
+    static std::set<void*> a;
+    return a;
+  }
+};
+
+/**
+ * Finalizer hint for an external ArrayBuffer over TFLite memory. Keeps the
+ * interpreter that owns the memory alive until the ArrayBuffer is collected.
+ */
+struct ExternalBufferHint {
+  void *data;
+  std::shared_ptr<InterpreterHandle> handle;
+};
+
+class TensorInfo : public Napi::ObjectWrap<TensorInfo> {
+ public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports) {
+    Napi::HandleScope scope(env);
+    Napi::Function func = DefineClass(env, "TensorInfo", {
+        InstanceAccessor<&TensorInfo::GetDataType>("dataType"),
+        InstanceAccessor<&TensorInfo::GetShape>("shape"),
+        InstanceAccessor<&TensorInfo::GetShapeSignature>("shapeSignature"),
+        InstanceAccessor<&TensorInfo::GetId>("id"),
+        InstanceAccessor<&TensorInfo::GetName>("name"),
+        InstanceAccessor<&TensorInfo::GetIsZeroCopy>("isZeroCopy"),
+        InstanceMethod<&TensorInfo::GetData>("data"),
+        InstanceMethod<&TensorInfo::SetData>("setData"),
+        InstanceMethod<&TensorInfo::DataAs>("dataAs"),
+        InstanceAccessor<&TensorInfo::GetQuantization>("quantization"),
+        InstanceMethod<&TensorInfo::SetFromFloat32>("setFromFloat32"),
+        InstanceMethod<&TensorInfo::DataAsFloat32>("dataAsFloat32"),
+        InstanceMethod<&TensorInfo::SetStrings>("setStrings"),
+        InstanceMethod<&TensorInfo::GetStrings>("getStrings"),
+        InstanceMethod<&TensorInfo::SetPreprocessing>("setPreprocessing"),
+        InstanceMethod<&TensorInfo::SetImage>("setImage"),
+        InstanceMethod<&TensorInfo::DecodeImage>("decodeImage"),
+      });
+
+    // Create a persistent reference to the class constructor. This lets us
+    // instantiate TensorInfos in the interpreter.
+    AddonData::Get(env)->tensorInfoConstructor = Napi::Persistent(func);
+
+    return exports;
+  }
+
+  TensorInfo(const Napi::CallbackInfo& info)
+      : Napi::ObjectWrap<TensorInfo>(info) { }
+
+  ~TensorInfo() {
+    dataArray.Unref();
+  }
+
+ private:
+  friend class Interpreter;
+  friend class InterpreterPool;
+  friend class PoolInferWorker;
+  friend class DecodeImageWorker;
+  friend class InferenceStream;
+  const TfLiteTensor *tensor = nullptr;
+  void *localData = nullptr;
+  int id = -1;
+  // True if 'dataArray' is backed directly by the TFLite tensor's memory, in
+  // which case no copies are needed before or after an invoke.
+  bool zeroCopy = false;
+  // True if the TFLite tensor holds newer output data than 'dataArray'. The
+  // copy is then made the next time data() is called.
+  bool stale = false;
+  // The owning interpreter's busy flag. Stale data is not copied while an
+  // invoke is running, since TFLite may be writing to the tensor.
+  const bool *interpreterBusy = nullptr;
+  // How setImage() turns pixels into tensor values.
+  image_preprocessing::Options preprocessing;
+  // True while decodeImage() is writing into the data array on a worker
+  // thread. The tensor must not be written, resized or run until it is done.
+  bool decoding = false;
+
+  /**
+   * The tensor a TensorInfo is bound to, along with its data array. Lets an
+   * Interpreter move TensorInfos between TFLite interpreters without
+   * reallocating their data arrays.
+   */
+  struct Binding {
+    const TfLiteTensor *tensor = nullptr;
+    void *localData = nullptr;
+    bool zeroCopy = false;
+    bool stale = false;
+    Napi::Reference<Napi::TypedArray> dataArray;
+  };
+
+  /**
+   * Move this TensorInfo's binding out, leaving it unbound.
+   */
+  Binding takeBinding() {
+    Binding binding;
+    binding.tensor = tensor;
+    binding.localData = localData;
+    binding.zeroCopy = zeroCopy;
+    binding.stale = stale;
+    binding.dataArray = std::move(dataArray);
+    tensor = nullptr;
+    localData = nullptr;
+    zeroCopy = false;
+    stale = false;
+    return binding;
+  }
+
+  void restoreBinding(Binding &binding) {
+    tensor = binding.tensor;
+    localData = binding.localData;
+    zeroCopy = binding.zeroCopy;
+    stale = binding.stale;
+    dataArray = std::move(binding.dataArray);
+  }
+  Napi::Reference<Napi::TypedArray> dataArray;
+
+  void throwIfError(Napi::Env &env, std::string message, TfLiteStatus status) {
+    if (status != kTfLiteOk) {
+      throw Napi::Error::New(env, message + ": " + decodeStatus(status));
+    }
+  }
+
+  /**
+   * Copy the tensor's local data to the TFLite tensor.
+   *
+   * This is necessary because we can't base the TypedArray off of the TFLite
+   * tensor's void* data pointer. If we do, we see the following error in node
+   * versions 13 through 16:
+   * # Fatal error in , line 0
+   * # Check failed: result.second.
+   */
+  void copyToTflite(Napi::Env &env) {
+    // String tensors are written and read in TFLite's memory directly.
+    if (zeroCopy || isStringTensor(tensor)) {
+      return;
+    }
+    throwIfError(env, "Failed to copy tensor data to TFLite",
+                 TfLiteTensorCopyFromBuffer((TfLiteTensor*) tensor, localData,
+                                            TfLiteTensorByteSize(tensor)));
+  }
+
+  /**
+   * Copy the TFLite tensor to local data.
+   */
+  void copyFromTflite(Napi::Env &env) {
+    if (zeroCopy || isStringTensor(tensor)) {
+      return;
+    }
+    throwIfError(env, "Failed to copy tensor data from TFLite",
+                 TfLiteTensorCopyToBuffer(tensor, localData,
+                                          TfLiteTensorByteSize(tensor)));
+  }
+
+  /**
+   * Whether the tensor's memory can back a JS ArrayBuffer directly. Only
+   * arena allocated tensors qualify. Dynamic tensors are reallocated by TFLite
+   * during invoke, so their address is not stable.
+   */
+  static bool canWrapTensorMemory(const TfLiteTensor *t) {
+    if (TfLiteTensorData(t) == nullptr || TfLiteTensorByteSize(t) == 0) {
+      return false;
+    }
+    switch (t->allocation_type) {
+      case kTfLiteArenaRw:
+      case kTfLiteArenaRwPersistent:
+      case kTfLiteCustom:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  /**
+   * Create an ArrayBuffer over the TFLite tensor's own memory. Returns an
+   * empty ArrayBuffer if the memory can't be wrapped safely, in which case the
+   * caller falls back to copying.
+   */
+  static Napi::ArrayBuffer wrapTensorMemory(
+      Napi::Env env, const TfLiteTensor *t,
+      const std::shared_ptr<InterpreterHandle> &handle) {
+    void *data = TfLiteTensorData(t);
+    if (!canWrapTensorMemory(t) || !ExternalBufferRegistry::TryAcquire(data)) {
+      return Napi::ArrayBuffer();
+    }
+    auto hint = new ExternalBufferHint{data, handle};
+    try {
+      return Napi::ArrayBuffer::New(
+          env, data, TfLiteTensorByteSize(t),
+          [](Napi::Env, void*, ExternalBufferHint *hint) {
+            ExternalBufferRegistry::Release(hint->data);
+            delete hint;
+          },
+          hint);
+    } catch (const Napi::Error &e) {
+      // Some runtimes don't allow external ArrayBuffers.
+      ExternalBufferRegistry::Release(data);
+      delete hint;
+      return Napi::ArrayBuffer();
+    }
+  }
+
+  /**
+   * Create a TypedArray of the JS type matching the TFLite tensor's type over
+   * 'buffer', which must hold at least TfLiteTensorByteSize(t) bytes.
+   */
+  static Napi::TypedArray createTypedArray(Napi::Env env, const TfLiteTensor *t,
+                                           Napi::ArrayBuffer buffer) {
+    Napi::TypedArray typedArray;
+    switch (TfLiteTensorType(t)) {
+    case kTfLiteNoType:
+      typedArray = Napi::Uint8Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteFloat32:
+      typedArray = Napi::Float32Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteInt32:
+      typedArray = Napi::Int32Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteUInt8:
+      typedArray = Napi::Uint8Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteInt64:
+      typedArray = Napi::BigInt64Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteString:
+      // The encoded string buffer. Use getStrings() to decode it.
+      typedArray = Napi::Uint8Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteBool:
+      typedArray = Napi::Uint8Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteInt16:
+      typedArray = Napi::Int16Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteComplex64:
+      throw Napi::Error::New(env, "'kTfLiteComplex64' is not yet supported");
+      break;
+    case kTfLiteInt8:
+      typedArray = Napi::Int8Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteFloat16:
+      // Raw half precision bits. Use dataAs() or setData() to convert them.
+      typedArray = Napi::Uint16Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteFloat64:
+      typedArray = Napi::Float64Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteComplex128:
+      throw Napi::Error::New(env, "'kTfLiteComplex128' is not yet supported");
+      break;
+    case kTfLiteUInt64:
+      typedArray = Napi::BigUint64Array::New(env, getLength(t), buffer, 0);
+      break;
+    case kTfLiteResource:
+      throw Napi::Error::New(env, "'kTfLiteResource' is not yet supported");
+      break;
+    case kTfLiteVariant:
+      throw Napi::Error::New(env, "'kTfLiteVariant' is not yet supported");
+      break;
+    case kTfLiteUInt32:
+      typedArray = Napi::Uint32Array::New(env, getLength(t), buffer, 0);
+      break;
+    }
+    return typedArray;
+  }
+
+  /**
+   * Whether a TypedArray of 'type' holds elements of the tensor's type, as
+   * the data array createTypedArray() makes for it does.
+   */
+  static bool matchesTensorType(napi_typedarray_type type,
+                                const TfLiteTensor *t) {
+    switch (TfLiteTensorType(t)) {
+      case kTfLiteFloat32:
+        return type == napi_float32_array;
+      case kTfLiteInt32:
+        return type == napi_int32_array;
+      case kTfLiteUInt8:
+      case kTfLiteBool:
+        return type == napi_uint8_array || type == napi_uint8_clamped_array;
+      case kTfLiteInt64:
+        return type == napi_bigint64_array;
+      case kTfLiteInt16:
+        return type == napi_int16_array;
+      case kTfLiteInt8:
+        return type == napi_int8_array;
+      case kTfLiteFloat16:
+        return type == napi_uint16_array;
+      case kTfLiteFloat64:
+        return type == napi_float64_array;
+      case kTfLiteUInt64:
+        return type == napi_biguint64_array;
+      case kTfLiteUInt32:
+        return type == napi_uint32_array;
+      default:
+        return false;
+    }
+  }
+
+  /**
+   * Point this TensorInfo at 't'. If 'handle' is given, try to back the data
+   * array with the tensor's memory instead of a separate JS-owned buffer.
+   */
+  void setTensor(Napi::Env env, const TfLiteTensor *t, int i,
+                 const std::shared_ptr<InterpreterHandle> &handle = nullptr) {
+    releaseTensorMemory();
+    tensor = t;
+    id = i;
+    // Reallocated tensors hold no results yet.
+    stale = false;
+
+    Napi::TypedArray typedArray;
+    if (isStringTensor(tensor)) {
+      // String tensors are resized as strings are set, so they have no fixed
+      // size data array. setStrings() and getStrings() access them instead.
+      zeroCopy = false;
+      Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, 0);
+      localData = buffer.Data();
+      typedArray = Napi::Uint8Array::New(env, 0, buffer, 0);
+    } else {
+      size_t byteSize = TfLiteTensorByteSize(tensor);
+      Napi::ArrayBuffer buffer;
+      if (handle) {
+        buffer = wrapTensorMemory(env, tensor, handle);
+      }
+      zeroCopy = !buffer.IsEmpty();
+      if (!zeroCopy) {
+        buffer = Napi::ArrayBuffer::New(env, byteSize);
+      }
+      localData = buffer.Data();
+      typedArray = createTypedArray(env, tensor, buffer);
+    }
+    // Start reference count at 1 since the Tensor object (this object) has a
+    // reference to the data array. This prevents JavaScript from GC-ing it.
+    dataArray = Napi::Reference<Napi::TypedArray>::New(typedArray, 1);
+  }
+
+  /**
+   * Point this TensorInfo at 't' after the interpreter's tensors have been
+   * reallocated. The data array is only rebuilt if its storage no longer
+   * matches the tensor, so arrays obtained before a reallocation that did not
+   * affect this tensor stay valid.
+   */
+  void updateTensor(Napi::Env env, const TfLiteTensor *t, int i,
+                    const std::shared_ptr<InterpreterHandle> &handle = nullptr) {
+    bool sameSize = !dataArray.IsEmpty()
+        && (isStringTensor(t)
+            || dataArray.Value().ByteLength() == TfLiteTensorByteSize(t));
+    bool sameMemory = zeroCopy ? TfLiteTensorData(t) == localData
+                               : handle == nullptr;
+    if (sameSize && sameMemory) {
+      tensor = t;
+      id = i;
+      stale = false;
+      return;
+    }
+    setTensor(env, t, i, handle);
+  }
+
+  /**
+   * Detach the data array if it is backed by TFLite memory. TFLite may free
+   * that memory when tensors are reallocated, and JavaScript could otherwise
+   * still read or write it through an old reference to the array.
+   */
+  void releaseTensorMemory() {
+    if (!zeroCopy || dataArray.IsEmpty()) {
+      return;
+    }
+#if NAPI_VERSION > 6
+    dataArray.Value().ArrayBuffer().Detach();
+#endif
+    zeroCopy = false;
+  }
+
+  Napi::Value GetId(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    return Napi::Number::New(env, id);
+  }
+
+  /**
+   * Whether the data array is TFLite's tensor memory. False if zero-copy was
+   * not requested, or if this tensor fell back to copying.
+   */
+  Napi::Value GetIsZeroCopy(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    return Napi::Boolean::New(env, zeroCopy);
+  }
+
+  Napi::Value GetName(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (tensor != nullptr) {
+      std::string name(TfLiteTensorName(tensor));
+      return Napi::String::New(env, name);
+    }
+    return Napi::String::New(env, "unknown tensor");
+  }
+
+  Napi::Value GetDataType(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    TfLiteType tensorType = TfLiteTensorType(tensor);
+    switch (tensorType) {
+      case kTfLiteNoType:
+        return Napi::String::New(env, "kTfLiteNoType");
+      case kTfLiteFloat32:
+        return Napi::String::New(env, "float32");
+      case kTfLiteInt32:
+        return Napi::String::New(env, "int32");
+      case kTfLiteUInt8:
+        return Napi::String::New(env, "uint8");
+      case kTfLiteInt64:
+        return Napi::String::New(env, "kTfLiteInt64");
+      case kTfLiteString:
+        return Napi::String::New(env, "string");
+      case kTfLiteBool:
+        return Napi::String::New(env, "bool");
+      case kTfLiteInt16:
+        return Napi::String::New(env, "int16");
+      case kTfLiteComplex64:
+        return Napi::String::New(env, "kTfLiteComplex64");
+      case kTfLiteInt8:
+        return Napi::String::New(env, "int8");
+      case kTfLiteFloat16:
+        return Napi::String::New(env, "float16");
+      case kTfLiteFloat64:
+        return Napi::String::New(env, "float64");
+      case kTfLiteComplex128:
+        return Napi::String::New(env, "kTfLiteComplex128");
+      case kTfLiteUInt64:
+        return Napi::String::New(env, "kTfLiteUInt64");
+      case kTfLiteResource:
+        return Napi::String::New(env, "kTfLiteResource");
+      case kTfLiteVariant:
+        return Napi::String::New(env, "kTfLiteVariant");
+      case kTfLiteUInt32:
+        return Napi::String::New(env, "uint32");
+      default:
+        return Napi::String::New(env, "Unknown data type");
+    }
+  }
+
+  Napi::Value GetShape(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    int numDims = TfLiteTensorNumDims(tensor);
+
+    std::stringstream shape;
+    for (int i = 0; i < numDims; i++) {
+      if (i != 0) {
+        shape << ",";
+      }
+      shape << TfLiteTensorDim(tensor, i);
+    }
+
+    return Napi::String::New(env, shape.str());
+  }
+
+  /**
+   * Like 'shape', but with -1 for dimensions the model allows to vary.
+   */
+  Napi::Value GetShapeSignature(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    const TfLiteIntArray *signature = tensor->dims_signature;
+    if (signature == nullptr || signature->size == 0) {
+      return GetShape(info);
+    }
+
+    std::stringstream shape;
+    for (int i = 0; i < signature->size; i++) {
+      if (i != 0) {
+        shape << ",";
+      }
+      shape << signature->data[i];
+    }
+
+    return Napi::String::New(env, shape.str());
+  }
+
+  static size_t getLength(const TfLiteTensor *tensor) {
+    TfLiteType tensorType = TfLiteTensorType(tensor);
+    size_t byteSize = TfLiteTensorByteSize(tensor);
+    switch (tensorType) {
+      case kTfLiteNoType:
+        return byteSize;
+      case kTfLiteFloat32:
+        return byteSize / 4;
+      case kTfLiteInt32:
+        return byteSize / 4;
+      case kTfLiteUInt8:
+        return byteSize;
+      case kTfLiteInt64:
+        return byteSize / 8;
+      case kTfLiteString:
+        return byteSize;
+      case kTfLiteBool:
+        return byteSize;
+      case kTfLiteInt16:
+        return byteSize / 2;
+      case kTfLiteComplex64:
+        return byteSize / 8;
+      case kTfLiteInt8:
+        return byteSize;
+      case kTfLiteFloat16:
+        return byteSize / 2;
+      case kTfLiteFloat64:
+        return byteSize / 8;
+      case kTfLiteComplex128:
+        return byteSize / 16;
+      case kTfLiteUInt64:
+        return byteSize / 8;
+      case kTfLiteResource:
+        return byteSize;
+      case kTfLiteVariant:
+        return byteSize;
+      case kTfLiteUInt32:
+        return byteSize / 4;
+      default:
+        return byteSize;
+    }
+  }
+
+  /**
+   * Mark the data array as out of date after an invoke, deferring the copy
+   * from TFLite until data() is called.
+   */
+  void markStale() {
+    stale = !zeroCopy;
+  }
+
+  /**
+   * With zero-copy, the data array is TFLite's own tensor memory, which an
+   * asynchronous invoke reads and writes from another thread, so every
+   * accessor of the data array checks this. Using a data array fetched
+   * before the invoke started is not checked and is unsafe until it
+   * finishes.
+   */
+  void throwIfSharedWhileBusy(Napi::Env env) {
+    if (zeroCopy && interpreterBusy && *interpreterBusy) {
+      throw Napi::Error::New(env, "Can not access the memory of tensor '"
+                             + std::string(TfLiteTensorName(tensor))
+                             + "' while the interpreter is busy, since it is "
+                             "shared with TFLite (zeroCopy)");
+    }
+  }
+
+  /**
+   * An output left stale by the last infer() can't be read while an
+   * asynchronous invoke runs: its data array holds older results, and TFLite
+   * is overwriting the latest ones.
+   */
+  void throwIfStaleWhileBusy(Napi::Env env) {
+    if (stale && interpreterBusy && *interpreterBusy) {
+      throw Napi::Error::New(env, "Can not read output '"
+                             + std::string(TfLiteTensorName(tensor))
+                             + "', which was not copied after the last "
+                             "inference, while the interpreter is busy");
+    }
+  }
+
+  Napi::Value GetData(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throwIfDecoding(env);
+    throwIfSharedWhileBusy(env);
+    throwIfStaleWhileBusy(env);
+    if (stale) {
+      copyFromTflite(env);
+      stale = false;
+    }
+    return dataArray.Value();
+  }
+
+  void throwIfUnbound(Napi::Env env) {
+    if (tensor == nullptr || dataArray.IsEmpty()) {
+      throw Napi::Error::New(env, "TensorInfo is not bound to a tensor");
+    }
+  }
+
+  /**
+   * The element type to convert to and from for the tensor's type.
+   */
+  static tensor_conversion::ElementType getElementType(
+      Napi::Env env, const TfLiteTensor *t) {
+    switch (TfLiteTensorType(t)) {
+      case kTfLiteFloat32:
+        return tensor_conversion::kFloat32;
+      case kTfLiteFloat64:
+        return tensor_conversion::kFloat64;
+      case kTfLiteFloat16:
+        return tensor_conversion::kFloat16;
+      case kTfLiteInt32:
+        return tensor_conversion::kInt32;
+      case kTfLiteUInt32:
+        return tensor_conversion::kUint32;
+      case kTfLiteInt16:
+        return tensor_conversion::kInt16;
+      case kTfLiteInt8:
+        return tensor_conversion::kInt8;
+      case kTfLiteUInt8:
+        return tensor_conversion::kUint8;
+      case kTfLiteBool:
+        return tensor_conversion::kBool;
+      default:
+        throw Napi::Error::New(env, "Can not convert data of tensor '"
+                               + std::string(TfLiteTensorName(t))
+                               + "' since its type is not supported");
+    }
+  }
+
+  static tensor_conversion::ElementType getElementType(
+      Napi::Env env, napi_typedarray_type type) {
+    switch (type) {
+      case napi_int8_array:
+        return tensor_conversion::kInt8;
+      case napi_uint8_array:
+      case napi_uint8_clamped_array:
+        return tensor_conversion::kUint8;
+      case napi_int16_array:
+        return tensor_conversion::kInt16;
+      case napi_uint16_array:
+        return tensor_conversion::kUint16;
+      case napi_int32_array:
+        return tensor_conversion::kInt32;
+      case napi_uint32_array:
+        return tensor_conversion::kUint32;
+      case napi_float32_array:
+        return tensor_conversion::kFloat32;
+      case napi_float64_array:
+        return tensor_conversion::kFloat64;
+      default:
+        throw Napi::TypeError::New(env, "BigInt arrays are not supported");
+    }
+  }
+
+  /**
+   * Parse a dtype name as accepted by dataAs() and create an uninitialized
+   * TypedArray of that type.
+   */
+  static Napi::TypedArray newTypedArray(
+      Napi::Env env, const std::string &dtype, size_t length,
+      tensor_conversion::ElementType *type) {
+    if (dtype == "int8") {
+      *type = tensor_conversion::kInt8;
+      return Napi::Int8Array::New(env, length);
+    } else if (dtype == "uint8") {
+      *type = tensor_conversion::kUint8;
+      return Napi::Uint8Array::New(env, length);
+    } else if (dtype == "bool") {
+      *type = tensor_conversion::kBool;
+      return Napi::Uint8Array::New(env, length);
+    } else if (dtype == "int16") {
+      *type = tensor_conversion::kInt16;
+      return Napi::Int16Array::New(env, length);
+    } else if (dtype == "int32") {
+      *type = tensor_conversion::kInt32;
+      return Napi::Int32Array::New(env, length);
+    } else if (dtype == "uint32") {
+      *type = tensor_conversion::kUint32;
+      return Napi::Uint32Array::New(env, length);
+    } else if (dtype == "float32") {
+      *type = tensor_conversion::kFloat32;
+      return Napi::Float32Array::New(env, length);
+    } else if (dtype == "float64") {
+      *type = tensor_conversion::kFloat64;
+      return Napi::Float64Array::New(env, length);
+    } else if (dtype == "float16") {
+      *type = tensor_conversion::kFloat16;
+      return Napi::Uint16Array::New(env, length);
+    }
+    throw Napi::TypeError::New(env, "Unsupported data type '" + dtype + "'");
+  }
+
+  static uint8_t *getTypedArrayData(Napi::TypedArray array) {
+    return static_cast<uint8_t*>(array.ArrayBuffer().Data())
+        + array.ByteOffset();
+  }
+
+  /**
+   * Convert the elements of a TypedArray of any type to the tensor's type and
+   * write them into its data array. This replaces
+   * 'data().set(TensorArray.from(array))' without the intermediate array.
+   */
+  void SetData(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throwIfUnbound(env);
+    throwIfDecoding(env);
+    throwIfSharedWhileBusy(env);
+    if (!info[0].IsTypedArray()) {
+      throw Napi::TypeError::New(env, "Expected a TypedArray");
+    }
+    Napi::TypedArray source = info[0].As<Napi::TypedArray>();
+    size_t length = getLength(tensor);
+    if (source.ElementLength() != length) {
+      throw Napi::RangeError::New(
+          env, "Expected " + std::to_string(length) + " elements but got "
+          + std::to_string(source.ElementLength()));
+    }
+
+    const uint8_t *sourceData = getTypedArrayData(source);
+    const uint8_t *target = static_cast<uint8_t*>(localData);
+    size_t sourceBytes = source.ByteLength();
+    std::vector<uint8_t> copy;
+    if (sourceData < target + TfLiteTensorByteSize(tensor)
+        && target < sourceData + sourceBytes) {
+      // The source is a view of the data array itself.
+      copy.assign(sourceData, sourceData + sourceBytes);
+      sourceData = copy.data();
+    }
+    tensor_conversion::convertElements(
+        sourceData, getElementType(env, source.TypedArrayType()),
+        localData, getElementType(env, tensor), length);
+    // The data array now holds the caller's data, not an older output.
+    stale = false;
+  }
+
+  /**
+   * Return a new TypedArray of the given dtype holding the tensor's elements.
+   * Stale outputs are converted straight from the TFLite tensor, without
+   * first being copied to the data array.
+   */
+  Napi::Value DataAs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throwIfUnbound(env);
+    throwIfDecoding(env);
+    throwIfSharedWhileBusy(env);
+    size_t length = getLength(tensor);
+    tensor_conversion::ElementType type;
+    Napi::TypedArray result = newTypedArray(
+        env, info[0].ToString().Utf8Value(), length, &type);
+
+    tensor_conversion::convertElements(
+        readableData(env), getElementType(env, tensor),
+        getTypedArrayData(result), type, length);
+    return result;
+  }
+
+  static bool isStringTensor(const TfLiteTensor *t) {
+    return TfLiteTensorType(t) == kTfLiteString;
+  }
+
+  void throwIfNotStringTensor(Napi::Env env) {
+    throwIfUnbound(env);
+    if (!isStringTensor(tensor)) {
+      throw Napi::Error::New(env, "Tensor '"
+                             + std::string(TfLiteTensorName(tensor))
+                             + "' is not a string tensor");
+    }
+    if (interpreterBusy && *interpreterBusy) {
+      throw Napi::Error::New(env, "Can not access string tensors while the "
+                             "interpreter is busy");
+    }
+  }
+
+  /**
+   * Encode strings into the tensor in TFLite's string buffer format, all in
+   * one call: the string count, the byte offset of each string and of the
+   * buffer's end, then the string bytes. Strings are encoded as UTF-8, and
+   * Uint8Arrays are copied as they are.
+   */
+  void SetStrings(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throwIfNotStringTensor(env);
+    if (!info[0].IsArray()) {
+      throw Napi::TypeError::New(env, "Expected an array of strings");
+    }
+    Napi::Array values = info[0].As<Napi::Array>();
+    uint32_t count = values.Length();
+
+    size_t elements = 1;
+    for (int i = 0; i < TfLiteTensorNumDims(tensor); i++) {
+      elements *= TfLiteTensorDim(tensor, i);
+    }
+    if (count != elements) {
+      throw Napi::RangeError::New(
+          env, "Expected " + std::to_string(elements) + " strings but got "
+          + std::to_string(count) + ". Use resizeInput() to change the "
+          "number of strings");
+    }
+    if (tensor->allocation_type != kTfLiteDynamic) {
+      throw Napi::Error::New(env, "Tensor '"
+                             + std::string(TfLiteTensorName(tensor))
+                             + "' can not be written to");
+    }
+
+    std::vector<std::string> strings(count);
+    size_t headerSize = sizeof(int32_t) * (count + 2);
+    size_t totalSize = headerSize;
+    for (uint32_t i = 0; i < count; i++) {
+      Napi::Value value = values.Get(i);
+      if (value.IsTypedArray()) {
+        Napi::TypedArray bytes = value.As<Napi::TypedArray>();
+        const char *data = reinterpret_cast<const char*>(
+            getTypedArrayData(bytes));
+        strings[i].assign(data, bytes.ByteLength());
+      } else if (value.IsString()) {
+        strings[i] = value.As<Napi::String>().Utf8Value();
+      } else {
+        throw Napi::TypeError::New(env, "Expected element "
+                                   + std::to_string(i)
+                                   + " to be a string or a Uint8Array");
+      }
+      totalSize += strings[i].size();
+    }
+    if (totalSize > INT32_MAX) {
+      throw Napi::RangeError::New(env, "The strings are too large");
+    }
+
+    TfLiteTensorRealloc(totalSize, const_cast<TfLiteTensor*>(tensor));
+    char *buffer = static_cast<char*>(TfLiteTensorData(tensor));
+    int32_t *header = reinterpret_cast<int32_t*>(buffer);
+    header[0] = static_cast<int32_t>(count);
+    size_t offset = headerSize;
+    for (uint32_t i = 0; i < count; i++) {
+      header[i + 1] = static_cast<int32_t>(offset);
+      std::memcpy(buffer + offset, strings[i].data(), strings[i].size());
+      offset += strings[i].size();
+    }
+    header[count + 1] = static_cast<int32_t>(offset);
+  }
+
+  /**
+   * Decode the tensor's strings, all in one call.
+   */
+  Napi::Value GetStrings(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throwIfNotStringTensor(env);
+    const char *buffer = static_cast<const char*>(TfLiteTensorData(tensor));
+    size_t byteSize = TfLiteTensorByteSize(tensor);
+    if (buffer == nullptr || byteSize < sizeof(int32_t)) {
+      return Napi::Array::New(env, 0);
+    }
+
+    const int32_t *header = reinterpret_cast<const int32_t*>(buffer);
+    int32_t count = header[0];
+    if (count < 0
+        || sizeof(int32_t) * (static_cast<size_t>(count) + 2) > byteSize) {
+      throw Napi::Error::New(env, "Malformed string tensor");
+    }
+    Napi::Array strings = Napi::Array::New(env, count);
+    for (int32_t i = 0; i < count; i++) {
+      int32_t start = header[i + 1];
+      int32_t end = header[i + 2];
+      if (start < 0 || end < start || static_cast<size_t>(end) > byteSize) {
+        throw Napi::Error::New(env, "Malformed string tensor");
+      }
+      strings.Set(static_cast<uint32_t>(i),
+                  Napi::String::New(env, buffer + start, end - start));
+    }
+    return strings;
+  }
+
+  /**
+   * The memory holding the tensor's latest data. Stale outputs are read from
+   * the TFLite tensor directly, without first being copied to the data array.
+   */
+  const void *readableData(Napi::Env env) {
+    throwIfStaleWhileBusy(env);
+    if (stale) {
+      return TfLiteTensorData(tensor);
+    }
+    return localData;
+  }
+
+  /**
+   * Per-tensor quantization parameters. Returns false if the tensor is not
+   * quantized, and throws if it is quantized per channel.
+   */
+  bool getQuantizationParams(Napi::Env env, TfLiteQuantizationParams *params) {
+    if (tensor->quantization.type == kTfLiteAffineQuantization) {
+      const TfLiteAffineQuantization *affine =
+          static_cast<const TfLiteAffineQuantization*>(
+              tensor->quantization.params);
+      if (affine != nullptr && affine->scale != nullptr
+          && affine->scale->size > 1) {
+        throw Napi::Error::New(env, "Tensor '"
+                               + std::string(TfLiteTensorName(tensor))
+                               + "' is quantized per channel, which is not "
+                               "supported");
+      }
+    }
+    *params = TfLiteTensorQuantizationParams(tensor);
+    return params->scale != 0;
+  }
+
+  /**
+   * The tensor's '{scale, zeroPoint}', or null if it is not quantized.
+   */
+  Napi::Value GetQuantization(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throwIfUnbound(env);
+    TfLiteQuantizationParams params;
+    if (!getQuantizationParams(env, &params)) {
+      return env.Null();
+    }
+    Napi::Object quantization = Napi::Object::New(env);
+    quantization.Set("scale", Napi::Number::New(env, params.scale));
+    quantization.Set("zeroPoint", Napi::Number::New(env, params.zero_point));
+    return quantization;
+  }
+
+  /**
+   * Quantize a Float32Array into the tensor's data array with the tensor's
+   * scale and zero point. Tensors that are not quantized just have the values
+   * converted to their type.
+   */
+  void SetFromFloat32(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throwIfUnbound(env);
+    throwIfDecoding(env);
+    throwIfSharedWhileBusy(env);
+    if (!info[0].IsTypedArray() || info[0].As<Napi::TypedArray>()
+        .TypedArrayType() != napi_float32_array) {
+      throw Napi::TypeError::New(env, "Expected a Float32Array");
+    }
+    Napi::Float32Array source = info[0].As<Napi::Float32Array>();
+    size_t length = getLength(tensor);
+    if (source.ElementLength() != length) {
+      throw Napi::RangeError::New(
+          env, "Expected " + std::to_string(length) + " elements but got "
+          + std::to_string(source.ElementLength()));
+    }
+
+    tensor_conversion::ElementType type = getElementType(env, tensor);
+    TfLiteQuantizationParams params;
+    if (getQuantizationParams(env, &params)) {
+      if (!tensor_conversion::quantizeFloat32(
+              source.Data(), localData, type, params.scale, params.zero_point,
+              length)) {
+        throw Napi::Error::New(env, "Can not quantize to the tensor's type");
+      }
+    } else {
+      tensor_conversion::convertElements(source.Data(),
+                                         tensor_conversion::kFloat32,
+                                         localData, type, length);
+    }
+    stale = false;
+  }
+
+  /**
+   * Return the tensor's data as a new Float32Array, dequantized with the
+   * tensor's scale and zero point if it is quantized.
+   */
+  Napi::Value DataAsFloat32(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throwIfUnbound(env);
+    throwIfDecoding(env);
+    throwIfSharedWhileBusy(env);
+    size_t length = getLength(tensor);
+    Napi::Float32Array result = Napi::Float32Array::New(env, length);
+
+    tensor_conversion::ElementType type = getElementType(env, tensor);
+    TfLiteQuantizationParams params;
+    if (getQuantizationParams(env, &params)) {
+      if (!tensor_conversion::dequantizeToFloat32(
+              readableData(env), type, result.Data(), params.scale,
+              params.zero_point, length)) {
+        throw Napi::Error::New(env, "Can not dequantize the tensor's type");
+      }
+    } else {
+      tensor_conversion::convertElements(readableData(env), type,
+                                         result.Data(),
+                                         tensor_conversion::kFloat32, length);
+    }
+    return result;
+  }
+
+  /**
+   * Read a per-channel option that is either a number or an array of 3
+   * numbers.
+   */
+  static void getChannelValues(Napi::Env env, Napi::Value value,
+                               const std::string &name, float *values) {
+    if (value.IsNumber()) {
+      float number = value.As<Napi::Number>().FloatValue();
+      values[0] = values[1] = values[2] = number;
+      return;
+    }
+    if (!value.IsArray() || value.As<Napi::Array>().Length() != 3) {
+      throw Napi::TypeError::New(env, "Expected '" + name + "' to be a "
+                                 "number or an array of 3 numbers");
+    }
+    Napi::Array array = value.As<Napi::Array>();
+    for (uint32_t i = 0; i < 3; i++) {
+      values[i] = array.Get(i).ToNumber().FloatValue();
+    }
+  }
+
+  /**
+   * Configure how setImage() converts pixels: the pixel format of the images
+   * and the mean and std to normalize each channel with. The options are kept
+   * until they are set again.
+   */
+  void SetPreprocessing(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsObject()) {
+      throw Napi::TypeError::New(env, "Expected an options object");
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    image_preprocessing::Options parsed;
+    if (options.Has("format")) {
+      std::string format = options.Get("format").ToString().Utf8Value();
+      if (!image_preprocessing::parsePixelFormat(format, &parsed.format)) {
+        throw Napi::TypeError::New(env, "Unknown pixel format '" + format
+                                   + "'");
+      }
+    }
+    if (options.Has("mean")) {
+      getChannelValues(env, options.Get("mean"), "mean", parsed.mean);
+    }
+    if (options.Has("std")) {
+      getChannelValues(env, options.Get("std"), "std", parsed.std);
+      for (float value : parsed.std) {
+        if (value == 0) {
+          throw Napi::RangeError::New(env, "'std' must not be 0");
+        }
+      }
+    }
+    preprocessing = parsed;
+  }
+
+  /**
+   * Crop, resize and normalize an image and write it into the tensor's data
+   * array in one pass. The tensor must have the shape [1, height, width,
+   * channels] or [height, width, channels] with 1 or 3 channels. Integer
+   * tensors are quantized with the tensor's scale and zero point.
+   */
+  void SetImage(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throwIfUnbound(env);
+    throwIfDecoding(env);
+    throwIfSharedWhileBusy(env);
+    if (!info[0].IsTypedArray() || info[0].As<Napi::TypedArray>()
+        .TypedArrayType() != napi_uint8_array) {
+      throw Napi::TypeError::New(env, "Expected the pixels in a Uint8Array");
+    }
+    if (!info[1].IsNumber() || !info[2].IsNumber()) {
+      throw Napi::TypeError::New(env, "Expected the image's width and height");
+    }
+    Napi::Uint8Array pixels = info[0].As<Napi::Uint8Array>();
+    image_preprocessing::Image image;
+    image.data = pixels.Data();
+    image.width = info[1].As<Napi::Number>().Int32Value();
+    image.height = info[2].As<Napi::Number>().Int32Value();
+    if (image.width <= 0 || image.height <= 0) {
+      throw Napi::RangeError::New(env, "The image must not be empty");
+    }
+    size_t expectedSize = image_preprocessing::imageSize(
+        preprocessing.format, image.width, image.height);
+    if (pixels.ByteLength() < expectedSize) {
+      throw Napi::RangeError::New(
+          env, "Expected at least " + std::to_string(expectedSize)
+          + " bytes of pixels but got " + std::to_string(pixels.ByteLength()));
+    }
+
+    image_preprocessing::Rect crop = {0, 0, image.width, image.height};
+    if (info.Length() > 3 && info[3].IsObject()) {
+      Napi::Object rect = info[3].As<Napi::Object>();
+      crop.x = rect.Get("x").ToNumber().Int32Value();
+      crop.y = rect.Get("y").ToNumber().Int32Value();
+      crop.width = rect.Get("width").ToNumber().Int32Value();
+      crop.height = rect.Get("height").ToNumber().Int32Value();
+    }
+
+    std::string error = image_preprocessing::preprocess(
+        image, crop, preprocessing, getImageOutput(env));
+    if (!error.empty()) {
+      throw Napi::Error::New(env, error);
+    }
+    stale = false;
+  }
+
+  void throwIfDecoding(Napi::Env env) {
+    if (decoding) {
+      throw Napi::Error::New(env, "An image is still being decoded into "
+                             "tensor '" + std::string(TfLiteTensorName(tensor))
+                             + "'. Wait for decodeImage() to finish first.");
+    }
+  }
+
+  /**
+   * Describe the tensor's data array as the NHWC image setImage() and
+   * decodeImage() write to.
+   */
+  image_preprocessing::Output getImageOutput(Napi::Env env) {
+    int numDims = TfLiteTensorNumDims(tensor);
+    int firstDim = numDims - 3;
+    if ((numDims != 3 && numDims != 4)
+        || (numDims == 4 && TfLiteTensorDim(tensor, 0) != 1)) {
+      throw Napi::Error::New(env, "Expected tensor '"
+                             + std::string(TfLiteTensorName(tensor))
+                             + "' to hold a single NHWC image");
+    }
+    image_preprocessing::Output output;
+    output.data = localData;
+    output.type = getElementType(env, tensor);
+    output.height = TfLiteTensorDim(tensor, firstDim);
+    output.width = TfLiteTensorDim(tensor, firstDim + 1);
+    output.channels = TfLiteTensorDim(tensor, firstDim + 2);
+    output.scale = 1;
+    output.zeroPoint = 0;
+    TfLiteQuantizationParams params;
+    if (getQuantizationParams(env, &params)) {
+      output.scale = params.scale;
+      output.zeroPoint = params.zero_point;
+    }
+    return output;
+  }
+
+  Napi::Value DecodeImage(const Napi::CallbackInfo &info);
+
+  /**
+   * The tensor's latest data for native post-processing, with its
+   * quantization parameters.
+   */
+  postprocessing::TensorData getTensorData(Napi::Env env) {
+    throwIfUnbound(env);
+    throwIfDecoding(env);
+    postprocessing::TensorData data;
+    data.data = readableData(env);
+    data.type = getElementType(env, tensor);
+    data.count = getLength(tensor);
+    data.scale = 1;
+    data.zeroPoint = 0;
+    TfLiteQuantizationParams params;
+    if (getQuantizationParams(env, &params)) {
+      data.scale = params.scale;
+      data.zeroPoint = params.zero_point;
+    }
+    return data;
+  }
+};
+
+/**
+ * Decodes a JPEG or PNG image into a TensorInfo's data array on the libuv
+ * thread pool, resizing and normalizing it like setImage().
+ */
+class DecodeImageWorker : public Napi::AsyncWorker {
+ public:
+  DecodeImageWorker(Napi::Env env, TensorInfo *tensorInfo,
+                    Napi::Uint8Array image, image_decoding::Options options)
+      : Napi::AsyncWorker(env, "tfjs_tflite_node:DecodeImageWorker"),
+        tensorInfo(tensorInfo),
+        deferred(Napi::Promise::Deferred::New(env)),
+        data(image.Data()),
+        size(image.ByteLength()),
+        preprocessing(tensorInfo->preprocessing),
+        output(tensorInfo->getImageOutput(env)),
+        options(options) {
+    // Keep the tensor and the compressed image alive until the worker is done.
+    tensorInfoRef = Napi::Persistent(tensorInfo->Value());
+    imageRef = Napi::Persistent(image);
+  }
+
+  Napi::Promise GetPromise() {
+    return deferred.Promise();
+  }
+
+ protected:
+  void Execute() override {
+    std::string error = image_decoding::decodeInto(data, size, preprocessing,
+                                                   output, options);
+    if (!error.empty()) {
+      SetError(error);
+    }
+  }
+
+  void OnOK() override {
+    tensorInfo->decoding = false;
+    tensorInfo->stale = false;
+    deferred.Resolve(Env().Undefined());
+  }
+
+  void OnError(const Napi::Error &e) override {
+    tensorInfo->decoding = false;
+    deferred.Reject(e.Value());
+  }
+
+ private:
+  TensorInfo *tensorInfo;
+  Napi::Promise::Deferred deferred;
+  Napi::ObjectReference tensorInfoRef;
+  Napi::Reference<Napi::Uint8Array> imageRef;
+  const uint8_t *data;
+  size_t size;
+  image_preprocessing::Options preprocessing;
+  image_preprocessing::Output output;
+  image_decoding::Options options;
+};
+
+/**
+ * Decode a JPEG or PNG image straight into the tensor on a worker thread.
+ * Resolves once the tensor holds the image.
+ */
+Napi::Value TensorInfo::DecodeImage(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  throwIfUnbound(env);
+  throwIfDecoding(env);
+  if (interpreterBusy && *interpreterBusy) {
+    throw Napi::Error::New(env, "Can not decode an image into a tensor while "
+                           "the interpreter is busy");
+  }
+  if (!info[0].IsTypedArray() || info[0].As<Napi::TypedArray>()
+      .TypedArrayType() != napi_uint8_array) {
+    throw Napi::TypeError::New(env, "Expected the image in a Uint8Array");
+  }
+  image_decoding::Options options;
+  if (info.Length() > 1 && info[1].IsObject()) {
+    Napi::Object object = info[1].As<Napi::Object>();
+    options.dctScaling = object.Get("dctScaling").ToBoolean().Value();
+    Napi::Value maxPixels = object.Get("maxPixels");
+    if (maxPixels.IsNumber()) {
+      double value = maxPixels.As<Napi::Number>().DoubleValue();
+      if (!(value >= 0)) {
+        throw Napi::RangeError::New(env, "maxPixels must not be negative");
+      }
+      options.maxPixels = static_cast<uint64_t>(std::min(value, 1e18));
+    }
+  }
+
+  // The worker deletes itself after OnOK or OnError runs.
+  DecodeImageWorker *worker = new DecodeImageWorker(
+      env, this, info[0].As<Napi::Uint8Array>(), options);
+  decoding = true;
+  worker->Queue();
+  return worker->GetPromise();
+}
+
+class Interpreter : public Napi::ObjectWrap<Interpreter> {
+ public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports) {
+    Napi::HandleScope scope(env);
+    Napi::Function func = DefineClass(env, "Interpreter", {
+        InstanceMethod<&Interpreter::GetInputs>("getInputs"),
+        InstanceMethod<&Interpreter::GetOutputs>("getOutputs"),
+        InstanceMethod<&Interpreter::Infer>("infer"),
+        InstanceMethod<&Interpreter::InferAsync>("inferAsync"),
+        InstanceMethod<&Interpreter::ResizeInput>("resizeInput"),
+        InstanceMethod<&Interpreter::SetLabels>("setLabels"),
+        InstanceMethod<&Interpreter::TopK>("topK"),
+        InstanceMethod<&Interpreter::SetDetection>("setDetection"),
+        InstanceMethod<&Interpreter::Detect>("detect"),
+      });
+
+    // Create a persistent reference to the class constructor. This will allow
+    // a function called on a class prototype and a function
+    // called on instance of a class to be distinguished from each other. It
+    // also lets the InterpreterPool create interpreters.
+    AddonData::Get(env)->interpreterConstructor = Napi::Persistent(func);
+    exports.Set("Interpreter", func);
+
+    return exports;
+  }
+
+  Interpreter(const Napi::CallbackInfo& info)
+      : Napi::ObjectWrap<Interpreter>(info) {
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+    AddonData::Get(env)->ReleasePending();
+
+    // Options are an object.
+    Napi::Object options = info[1].As<Napi::Object>();
+    apply_options(env, options);
+
+    // TODO: Throw error on incorrect argument types.
+    // Get the model from the registry so that interpreters created from the
+    // same bytes or file share one copy of the weights.
+    std::shared_ptr<SharedModel> model;
+    // Copy the model into the placement's NUMA node.
+    thread_affinity::Scope placement(affinity);
+    if (info[0].IsString()) {
+      // Model is a path to a file, which TFLite memory-maps.
+      std::string path = info[0].As<Napi::String>().Utf8Value();
+      model = ModelRegistry::GetOrCreateFromFile(path);
+      if (!model) {
+        throw Napi::Error::New(env, "Failed to create tflite model from file '"
+                               + path + "'.");
+      }
+    } else if (info[0].IsTypedArray()) {
+      // Model is a Uint8Array, usually over a SharedArrayBuffer that several
+      // worker threads build interpreters from. It is used in place, so the
+      // weights exist once no matter how many workers use them, unless the
+      // interpreter is placed on a NUMA node, which gets its own copy.
+      Napi::TypedArray array = info[0].As<Napi::TypedArray>();
+      if (array.TypedArrayType() != napi_uint8_array) {
+        throw Napi::TypeError::New(env, "Expected the model in a Uint8Array");
+      }
+      Napi::Uint8Array bytes = array.As<Napi::Uint8Array>();
+      if (affinity.numaNode >= 0) {
+        model = ModelRegistry::GetOrCreate(
+            bytes.Data(), bytes.ByteLength(), affinity.numaNode);
+      } else {
+        model = ModelRegistry::GetOrCreateInPlace(bytes);
+      }
+      if (!model) {
+        throw Napi::Error::New(env, "Failed to create tflite model.");
+      }
+    } else {
+      // Model is stored as a uint8 buffer.
+      Napi::ArrayBuffer buffer = info[0].As<Napi::ArrayBuffer>();
+      model = ModelRegistry::GetOrCreate(
+          (uint8_t*) buffer.Data(), buffer.ByteLength(), affinity.numaNode);
+      if (!model) {
+        throw Napi::Error::New(env, "Failed to create tflite model.");
+      }
+    }
+
+    handle = create_handle(env, model);
+    interpreter = handle->interpreter;
+
+    // Allocate tensors
+    throw_if_tflite_error(env, "Failed to allocate tensors",
+                handle->allocate());
+
+    // Get input tensors
+    auto inputs = make_tensors(env, interpreter, /* input? */ true);
+    // Start with a refcount of 1. Otherwise, it will get garbage collected,
+    // since we haven't passed it to JavaScript yet.
+    inputTensorRef = Napi::Reference<Napi::Array>::New(inputs.first, 1);
+    inputTensors = inputs.second;
+
+    // Get output tensors
+    auto outputs = make_tensors(env, interpreter, /* input? */ false);
+    outputTensorRef = Napi::Reference<Napi::Array>::New(outputs.first, 1);
+    outputTensors = outputs.second;
+  }
+
+  Napi::Value GetInputs(const Napi::CallbackInfo& info) {
+    return inputTensorRef.Value();
+  }
+
+  Napi::Value GetOutputs(const Napi::CallbackInfo& info) {
+    return outputTensorRef.Value();
+  }
+
+  ~Interpreter() {
+    inputTensorRef.Unref();
+    outputTensorRef.Unref();
+    AddonData::Get(Env())->ReleasePending();
+    // The TFLite interpreter itself is deleted once the last zero-copy
+    // ArrayBuffer over its memory is collected.
+  }
+
+ private:
+  friend class InferWorker;
+  friend class InterpreterPool;
+  friend class PoolInferWorker;
+  friend class InferenceStream;
+
+  /**
+   * A TFLite interpreter allocated for one set of input shapes, along with the
+   * TensorInfo data arrays bound to its tensors.
+   */
+  struct ShapePlan {
+    std::string key;
+    std::shared_ptr<InterpreterHandle> handle;
+    std::vector<TensorInfo::Binding> inputs;
+    std::vector<TensorInfo::Binding> outputs;
+  };
+
+  std::shared_ptr<InterpreterHandle> handle;
+  TfLiteInterpreter *interpreter = nullptr;
+  std::vector<TensorInfo*> inputTensors;
+  Napi::Reference<Napi::Array> inputTensorRef;
+  std::vector<TensorInfo*> outputTensors;
+  Napi::Reference<Napi::Array> outputTensorRef;
+  // Parsed options, kept so that more TFLite interpreters can be created for
+  // the same model.
+  int threads = 0;
+  struct DelegateConfig {
+    std::string path;
+    std::vector<std::pair<std::string, std::string>> options;
+    // Directory the delegate serializes its compiled graph to, if it supports
+    // serialization.
+    std::string cacheDir;
+  };
+  // External delegates, in the order they are applied.
+  std::vector<DelegateConfig> delegate_configs;
+  // If true, an XNNPACK delegate configured by the options below is applied
+  // after the external delegates. Otherwise TFLite's own default applies.
+  bool xnnpack = false;
+  // XNNPACK threads. If zero, 'threads' is used.
+  int xnnpack_threads = 0;
+  // Also run signed and unsigned 8-bit quantized operators with XNNPACK.
+  bool xnnpack_quantized = false;
+  // CPUs and NUMA node to run on and allocate from.
+  thread_affinity::Placement affinity;
+  // If true, TensorInfo data arrays share memory with the TFLite tensors
+  // instead of being copied to and from them on every invoke.
+  bool zeroCopy = false;
+  // If true, outputs are only copied from TFLite when their data is read,
+  // unless infer() is told which outputs to copy.
+  bool lazyOutputs = false;
+  // The maximum number of inactive shape plans to keep. If zero, resizing an
+  // input reallocates the interpreter's tensors in place. The C API does not
+  // expose arena sizes, so plans are counted rather than measured.
+  size_t shapeCacheSize = 0;
+  // Recently used shape plans other than the active one, most recent first.
+  std::list<ShapePlan> shapeCache;
+  // True while an inferAsync() call is running on a worker thread. The
+  // interpreter, its tensors, and its error stream must not be touched from
+  // JavaScript until the worker completes.
+  bool busy = false;
+  // Class labels for topK(), by output index.
+  std::map<size_t, std::vector<std::string>> labels;
+  // The outputs and options detect() decodes, set by setDetection().
+  struct DetectionConfig {
+    size_t boxes;
+    size_t scores;
+    postprocessing::DetectionOptions options;
+  };
+  std::unique_ptr<DetectionConfig> detection;
+
+  void apply_options(Napi::Env &env, Napi::Object &options) {
+    // Set number of threads from options.
+    auto maybeThreads = options.Get("threads");
+    if (maybeThreads.IsNumber()) {
+      threads = maybeThreads.ToNumber().Int32Value();
+    }
+
+    auto maybeZeroCopy = options.Get("zeroCopy");
+    if (maybeZeroCopy.IsBoolean()) {
+      zeroCopy = maybeZeroCopy.As<Napi::Boolean>().Value();
+#if NAPI_VERSION <= 6
+      // Without ArrayBuffer detaching, data arrays would keep pointing at
+      // tensor memory TFLite frees when it reallocates.
+      if (zeroCopy) {
+        throw Napi::Error::New(env, "zeroCopy requires N-API version 7 or "
+                               "later");
+      }
+#endif
+    }
+
+    auto maybeLazyOutputs = options.Get("lazyOutputs");
+    if (maybeLazyOutputs.IsBoolean()) {
+      lazyOutputs = maybeLazyOutputs.As<Napi::Boolean>().Value();
+    }
+
+    auto maybeShapeCacheSize = options.Get("shapeCacheSize");
+    if (maybeShapeCacheSize.IsNumber()) {
+      shapeCacheSize = maybeShapeCacheSize.ToNumber().Uint32Value();
+    }
+
+    auto maybeXnnpack = options.Get("xnnpack");
+    if (maybeXnnpack.IsBoolean()) {
+      xnnpack = maybeXnnpack.As<Napi::Boolean>().Value();
+    } else if (maybeXnnpack.IsObject()) {
+      Napi::Object xnnpack_config = maybeXnnpack.As<Napi::Object>();
+      xnnpack = true;
+      auto maybeXnnpackThreads = xnnpack_config.Get("threads");
+      if (maybeXnnpackThreads.IsNumber()) {
+        xnnpack_threads = maybeXnnpackThreads.ToNumber().Int32Value();
+      }
+      xnnpack_quantized = xnnpack_config.Get("quantized").ToBoolean().Value();
+    }
+#ifndef TFLITE_NODE_XNNPACK
+    if (xnnpack) {
+      throw Napi::Error::New(env, "This build of tfjs-tflite-node does not "
+                             "include the XNNPACK delegate");
+    }
+#endif
+
+    auto maybeAffinity = options.Get("affinity");
+    if (maybeAffinity.IsObject()) {
+      Napi::Object affinity_config = maybeAffinity.As<Napi::Object>();
+      auto maybeCpus = affinity_config.Get("cpus");
+      if (maybeCpus.IsArray()) {
+        Napi::Array cpus = maybeCpus.As<Napi::Array>();
+        for (uint32_t i = 0; i < cpus.Length(); i++) {
+          affinity.cpus.push_back(cpus.Get(i).ToNumber().Int32Value());
+        }
+      }
+      auto maybeNumaNode = affinity_config.Get("numaNode");
+      if (maybeNumaNode.IsNumber()) {
+        affinity.numaNode = maybeNumaNode.ToNumber().Int32Value();
+      }
+      std::string error = thread_affinity::resolve(&affinity);
+      if (!error.empty()) {
+        throw Napi::Error::New(env, error);
+      }
+    }
+
+    if (options.Has("delegates")) {
+      auto delegates = options.Get("delegates").As<Napi::Array>();
+      for (uint32_t i = 0; i < delegates.Length(); i++) {
+        auto delegate_config = delegates.Get(i).As<Napi::Object>();
+        delegate_configs.push_back(parse_delegate_config(env, delegate_config));
+      }
+    } else if (options.Has("delegate")) {
+      auto delegate_config = options.Get("delegate").As<Napi::Object>();
+      delegate_configs.push_back(parse_delegate_config(env, delegate_config));
+    }
+  }
+
+  DelegateConfig parse_delegate_config(Napi::Env &env,
+                                       Napi::Object &delegate_config) {
+    DelegateConfig config;
+    config.path = delegate_config.Get("path").As<Napi::String>().Utf8Value();
+    auto delegate_options_array = delegate_config.Get("options").As<Napi::Array>();
+    config.options = parse_delegate_options(env, delegate_options_array);
+    auto maybeCacheDir = delegate_config.Get("cacheDir");
+    if (maybeCacheDir.IsString()) {
+      config.cacheDir = maybeCacheDir.As<Napi::String>().Utf8Value();
+    }
+    return config;
+  }
+
+  /**
+   * Create a TFLite interpreter for 'model' using the parsed options. Tensors
+   * are not allocated yet.
+   */
+  std::shared_ptr<InterpreterHandle> create_handle(
+      Napi::Env &env, const std::shared_ptr<SharedModel> &model) {
+    auto new_handle = std::make_shared<InterpreterHandle>();
+    new_handle->model = model;
+    new_handle->placement = affinity;
+    new_handle->options = TfLiteInterpreterOptionsCreate();
+    // Delegates create their threads, and XNNPACK packs weights, here.
+    thread_affinity::Scope placement(affinity);
+
+    int num_threads = ThreadBudget::Clamp(threads);
+    if (num_threads > 0) {
+      TfLiteInterpreterOptionsSetNumThreads(new_handle->options, num_threads);
+    }
+
+    // Create a custom error reporter so JS errors can have meaningful messages.
+    TfLiteInterpreterOptionsSetErrorReporter(new_handle->options, report_error,
+                                             &new_handle->errorStream);
+
+    // Names of the delegates, in the order they are applied, for errors.
+    std::vector<std::string> delegate_names;
+    // Cache entries of the delegates that serialize their compiled graph,
+    // counted once the delegates are applied.
+    std::vector<DelegateCache::Entry> cache_entries;
+    for (const DelegateConfig &config : delegate_configs) {
+      TfLiteExternalDelegateOptions delegate_options =
+          TfLiteExternalDelegateOptionsDefault(config.path.c_str());
+
+      // Options are inserted as char*, so 'delegate_strings' must stay
+      // allocated until the delegate is created.
+      std::vector<std::pair<std::string, std::string>> delegate_strings =
+          config.options;
+      if (!config.cacheDir.empty()) {
+        cache_entries.push_back(
+            add_cache_options(env, *model, config, delegate_strings));
+      }
+      fill_delegate_options(env, delegate_options, delegate_strings);
+
+      TfLiteDelegate* delegate = TfLiteExternalDelegateCreate(&delegate_options);
+      if (!delegate) {
+        throw Napi::Error::New(env, "Failed to create delegate from '"
+                               + config.path + "'");
+      }
+      new_handle->delegates.emplace_back(delegate,
+                                         &TfLiteExternalDelegateDelete);
+      delegate_names.push_back("'" + config.path + "'");
+    }
+
+#ifdef TFLITE_NODE_XNNPACK
+    int xnnpack_num_threads = 0;
+    if (xnnpack) {
+      TfLiteXNNPackDelegateOptions xnnpack_options =
+          TfLiteXNNPackDelegateOptionsDefault();
+      xnnpack_num_threads = xnnpack_threads > 0
+          ? ThreadBudget::Clamp(xnnpack_threads) : num_threads;
+      xnnpack_options.num_threads = xnnpack_num_threads;
+      if (xnnpack_quantized) {
+        xnnpack_options.flags |= TFLITE_XNNPACK_DELEGATE_FLAG_QS8
+            | TFLITE_XNNPACK_DELEGATE_FLAG_QU8;
+      }
+      TfLiteDelegate *delegate = TfLiteXNNPackDelegateCreate(&xnnpack_options);
+      if (!delegate) {
+        throw Napi::Error::New(env, "Failed to create the XNNPACK delegate");
+      }
+      new_handle->delegates.emplace_back(delegate,
+                                         &TfLiteXNNPackDelegateDelete);
+      delegate_names.push_back("XNNPACK");
+    }
+#endif
+
+    new_handle->interpreter = TfLiteInterpreterCreate(model->model,
+                                                      new_handle->options);
+    if (!new_handle->interpreter) {
+      throw Napi::Error::New(env, "Failed to create tflite interpreter. "
+                             + new_handle->errorStream.str());
+    }
+    apply_delegates(env, *new_handle, delegate_names);
+    for (const DelegateCache::Entry &entry : cache_entries) {
+      DelegateCache::Count(entry);
+    }
+    // TFLite runs on one thread unless told otherwise.
+    new_handle->threads = std::max(num_threads, 1);
+#ifdef TFLITE_NODE_XNNPACK
+    new_handle->threads = std::max(new_handle->threads, xnnpack_num_threads);
+#endif
+    ThreadBudget::Register(new_handle->threads);
+    return new_handle;
+  }
+
+  /**
+   * Apply the handle's delegates in order. Each one claims the operators it
+   * supports among those the earlier ones left, so an accelerator can be
+   * followed by a CPU delegate, and operators none of them claim run on
+   * TFLite's built-in kernels. They are applied one at a time, rather than
+   * through the interpreter options, so that an error can report the status
+   * of each.
+   */
+  void apply_delegates(Napi::Env &env, InterpreterHandle &target,
+                       const std::vector<std::string> &names) {
+    std::vector<TfLiteStatus> statuses;
+    for (const auto &delegate : target.delegates) {
+      statuses.push_back(TfLiteInterpreterModifyGraphWithDelegate(
+          target.interpreter, delegate.first));
+      if (statuses.back() != kTfLiteOk) {
+        break;
+      }
+    }
+    if (statuses.empty() || statuses.back() == kTfLiteOk) {
+      return;
+    }
+
+    // TFLite undoes every delegate when one fails, so the error lists them
+    // all.
+    std::stringstream message;
+    message << "Failed to apply delegates.";
+    for (size_t i = 0; i < names.size(); i++) {
+      message << " " << names[i] << ": "
+              << (i < statuses.size() ? decodeStatus(statuses[i])
+                                      : "Not applied")
+              << ".";
+    }
+    message << " " << target.errorStream.str();
+    throw Napi::Error::New(env, message.str());
+  }
+
+  /**
+   * Point a delegate that supports serialization at the cache directory,
+   * using the option names of TFLite's GPU delegate, and look up its entry.
+   * Options the user set themselves are left alone.
+   */
+  DelegateCache::Entry add_cache_options(
+      Napi::Env &env, SharedModel &model, const DelegateConfig &config,
+      std::vector<std::pair<std::string, std::string>> &delegate_strings) {
+    std::string model_key = DelegateCache::ModelKey(model);
+    if (model_key.empty()) {
+      throw Napi::Error::New(env, "Failed to read the model file '" +
+                             model.path + "' to key the delegate cache");
+    }
+    std::string token = DelegateCache::Token(model_key, config.path,
+                                             config.options);
+    // The entry is looked up where the delegate will actually look.
+    std::string dir = config.cacheDir;
+    bool has_dir = false;
+    bool has_token = false;
+    for (const auto &option : delegate_strings) {
+      if (option.first == "serialization_dir") {
+        dir = option.second;
+        has_dir = true;
+      } else if (option.first == "model_token") {
+        token = option.second;
+        has_token = true;
+      }
+    }
+    if (!has_dir) {
+      delegate_strings.emplace_back("serialization_dir", dir);
+    }
+    if (!has_token) {
+      delegate_strings.emplace_back("model_token", token);
+    }
+    DelegateCache::Entry entry;
+    std::string error = DelegateCache::Find(dir, token, &entry);
+    if (!error.empty()) {
+      throw Napi::Error::New(env, error);
+    }
+    return entry;
+  }
+
+  void fill_delegate_options(
+      Napi::Env &env,
+      TfLiteExternalDelegateOptions &delegate_options,
+      const std::vector<std::pair<std::string, std::string>> &options) {
+    for (const auto &option : options) {
+      auto status = delegate_options.insert(&delegate_options,
+                                            option.first.c_str(),
+                                            option.second.c_str());
+      throw_if_tflite_error(env, "Failed to set delegate options", status);
+    }
+  }
+
+  std::vector<std::pair<std::string, std::string>> parse_delegate_options(
+      Napi::Env &env, Napi::Array &options) {
+
+    std::vector<std::pair<std::string, std::string>> options_vec;
+    for (uint32_t i = 0; i < options.Length(); i++) {
+      Napi::Value option = options.Get(i);
+      if (!option.IsArray()) {
+        throw Napi::Error::New(env, "Expected option to be an array but got "
+                               + option.ToString().Utf8Value());
+      }
+      Napi::Array as_array = option.As<Napi::Array>();
+      options_vec.push_back(parse_delegate_option(env, as_array));
+    }
+    return options_vec;
+  }
+
+  std::pair<std::string, std::string> parse_delegate_option(
+      Napi::Env &env, Napi::Array &option) {
+
+    std::pair<std::string, std::string> pair;
+    auto first = option.Get((uint32_t) 0);
+    if (!first.IsString()) {
+      throw Napi::Error::New(env, "Expected option key to be a string but got "
+                       + option.ToString().Utf8Value());
+    }
+
+    auto second = option.Get((uint32_t) 1);
+    if (!second.IsString()) {
+      throw Napi::Error::New(env, "Expected option value to be a string but got "
+                       + option.ToString().Utf8Value());
+    }
+
+    pair.first = first.As<Napi::String>().Utf8Value();
+    pair.second = second.As<Napi::String>().Utf8Value();
+    return pair;
+  }
+
+  std::pair<Napi::Array, std::vector<TensorInfo*>> make_tensors(
+      Napi::Env &env, TfLiteInterpreter* interpreter, bool get_inputs) {
+    // Functions to get data from TfLite.
+    int32_t(*get_count)(const TfLiteInterpreter*);
+    TfLiteTensor*(*get_tensor)(const TfLiteInterpreter*, int32_t);
+
+    if (get_inputs) {
+      get_count = &TfLiteInterpreterGetInputTensorCount;
+      get_tensor = &TfLiteInterpreterGetInputTensor;
+    } else {
+      get_count = &TfLiteInterpreterGetOutputTensorCount;
+      // Cast the function type because GetOutputTensor returns const tensors.
+      get_tensor = (TfLiteTensor*(*)(const TfLiteInterpreter*, int32_t))
+                   &TfLiteInterpreterGetOutputTensor;
+    }
+
+    int32_t tensor_count = get_count(interpreter);
+    Napi::Array tensor_array = Napi::Array::New(env, tensor_count);
+    std::vector<TensorInfo*> tensor_vector;
+    for (int id = 0; id < tensor_count; id++) {
+      const TfLiteTensor* tensor = get_tensor(interpreter, id);
+      auto wrapped_tensor_info =
+          AddonData::Get(env)->tensorInfoConstructor.New({});
+      auto tensor_info = TensorInfo::Unwrap(wrapped_tensor_info);
+      tensor_info->interpreterBusy = &busy;
+      tensor_info->setTensor(env, tensor, id,
+                             zeroCopy ? handle : nullptr);
+      tensor_array[id] = wrapped_tensor_info;
+      tensor_vector.push_back(tensor_info);
+    }
+    return std::pair<Napi::Array, std::vector<TensorInfo*>>(tensor_array,
+                                                            tensor_vector);
+  }
+
+  /**
+   * This function is passed to tflite as an error reporter. It appends
+   * errors to the stringstream passed to it as error_stream.
+   */
+  static void report_error(void* error_stream, const char* format, va_list args) {
+    std::stringstream *err = (std::stringstream*) error_stream;
+    char err_message_buffer[MAX_ERROR_LEN];
+    std::vsnprintf(err_message_buffer, MAX_ERROR_LEN, format, args);
+    *err << err_message_buffer << std::endl;
+  }
+
+  /**
+   * Get the error messages reported by 'report_error' and clear the error
+   * stream.
+   */
+  std::string get_and_clear_error_message() {
+    if (!handle) {
+      return "";
+    }
+    std::string error_message = handle->errorStream.str();
+    handle->errorStream.str(std::string());
+    return error_message;
+  }
+
+  /**
+   * Throw an error if the TfLiteStatus is not okay. Includes the 'message' in
+   * error and appends a description of the TfLite error along with any error
+   * messages reported by TfLite.
+   */
+  void throw_if_tflite_error(Napi::Env &env, std::string message, TfLiteStatus status) {
+    if (status != kTfLiteOk) {
+      throw Napi::Error::New(env, tflite_error_message(message, status));
+    }
+  }
+
+  std::string tflite_error_message(std::string message, TfLiteStatus status) {
+    return message + ": " + decodeStatus(status) + ". "
+        + get_and_clear_error_message();
+  }
+
+  void throw_if_busy(Napi::Env &env) {
+    if (busy) {
+      throw Napi::Error::New(env, "Interpreter is busy. Wait for the pending "
+                             "inferAsync() call to finish before using it.");
+    }
+    for (TensorInfo *tensor : inputTensors) {
+      tensor->throwIfDecoding(env);
+    }
+  }
+
+  void copy_inputs_to_tflite(Napi::Env &env) {
+    for (TensorInfo* tensor : inputTensors) {
+      tensor->copyToTflite(env);
+    }
+  }
+
+  void copy_outputs_from_tflite(Napi::Env &env) {
+    for (TensorInfo* tensor : outputTensors) {
+      tensor->copyFromTflite(env);
+      tensor->stale = false;
+    }
+  }
+
+  /**
+   * Copy the outputs selected by 'eager' from TFLite and mark the rest stale,
+   * so they are only copied if their data is read.
+   */
+  void copy_outputs_from_tflite(Napi::Env &env, const std::vector<bool> &eager) {
+    for (size_t i = 0; i < outputTensors.size(); i++) {
+      if (eager[i]) {
+        outputTensors[i]->copyFromTflite(env);
+        outputTensors[i]->stale = false;
+      } else {
+        outputTensors[i]->markStale();
+      }
+    }
+  }
+
+  /**
+   * Parse the optional '{outputs: Array<number|string>}' argument of infer()
+   * into the outputs that should be copied eagerly. Outputs can be given by
+   * index or by name. Without it, all outputs are copied eagerly unless the
+   * interpreter was created with 'lazyOutputs'.
+   */
+  std::vector<bool> parse_output_selection(Napi::Env env, Napi::Value arg) {
+    if (!arg.IsObject() || !arg.As<Napi::Object>().Has("outputs")) {
+      return std::vector<bool>(outputTensors.size(), !lazyOutputs);
+    }
+    Napi::Value outputs = arg.As<Napi::Object>().Get("outputs");
+    if (!outputs.IsArray()) {
+      throw Napi::TypeError::New(env, "Expected 'outputs' to be an array of "
+                                 "output indices or names");
+    }
+
+    std::vector<bool> eager(outputTensors.size(), false);
+    Napi::Array selected = outputs.As<Napi::Array>();
+    for (uint32_t i = 0; i < selected.Length(); i++) {
+      Napi::Value output = selected.Get(i);
+      eager[find_output(env, output)] = true;
+    }
+    return eager;
+  }
+
+  size_t find_output(Napi::Env env, Napi::Value output) {
+    if (output.IsNumber()) {
+      int32_t index = output.As<Napi::Number>().Int32Value();
+      if (index < 0 || index >= (int32_t) outputTensors.size()) {
+        throw Napi::RangeError::New(env, "Output index "
+                                    + std::to_string(index)
+                                    + " is out of range");
+      }
+      return index;
+    }
+    std::string name = output.ToString().Utf8Value();
+    for (size_t i = 0; i < outputTensors.size(); i++) {
+      if (name == TfLiteTensorName(outputTensors[i]->tensor)) {
+        return i;
+      }
+    }
+    throw Napi::Error::New(env, "The model has no output named '"
+                           + name + "'");
+  }
+
+  Napi::Value Infer(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throw_if_busy(env);
+    std::vector<bool> eager = parse_output_selection(env, info[0]);
+
+    copy_inputs_to_tflite(env);
+
+    TfLiteStatus status;
+    {
+      ThreadBudget::Scope budget(handle->threads);
+      status = handle->invoke();
+    }
+    throw_if_tflite_error(env, "Failed to invoke interpreter", status);
+
+    copy_outputs_from_tflite(env, eager);
+
+    return Napi::Boolean::New(env, true);
+  }
+
+  Napi::Value InferAsync(const Napi::CallbackInfo &info);
+
+  /**
+   * setLabels(output: number|string, labels: string[]|null)
+   *
+   * Set the class names that topK() returns for an output's indices, or
+   * remove them if 'labels' is null.
+   */
+  void SetLabels(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    size_t index = find_output(env, info[0]);
+    if (info[1].IsNull() || info[1].IsUndefined()) {
+      labels.erase(index);
+      return;
+    }
+    if (!info[1].IsArray()) {
+      throw Napi::TypeError::New(env, "Expected an array of labels");
+    }
+    Napi::Array values = info[1].As<Napi::Array>();
+    std::vector<std::string> names(values.Length());
+    for (uint32_t i = 0; i < values.Length(); i++) {
+      names[i] = values.Get(i).ToString().Utf8Value();
+    }
+    labels[index] = std::move(names);
+  }
+
+  /**
+   * topK(output: number|string, k: number)
+   *
+   * Find the 'k' highest scores of an output straight from its buffer,
+   * dequantizing them if the output is quantized, without copying the output
+   * to JavaScript. Returns '{indices, scores}', highest first, along with
+   * 'labels' if setLabels() was called for the output. Indices without a
+   * label get an empty string.
+   */
+  Napi::Value TopK(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throw_if_busy(env);
+    size_t index = find_output(env, info[0]);
+    if (!info[1].IsNumber() || info[1].As<Napi::Number>().Int64Value() < 1) {
+      throw Napi::RangeError::New(env, "Expected k to be a positive number");
+    }
+    size_t k = static_cast<size_t>(info[1].As<Napi::Number>().Int64Value());
+
+    std::vector<postprocessing::ScoredIndex> top = postprocessing::topK(
+        outputTensors[index]->getTensorData(env), k);
+
+    Napi::Int32Array indices = Napi::Int32Array::New(env, top.size());
+    Napi::Float32Array values = Napi::Float32Array::New(env, top.size());
+    for (size_t i = 0; i < top.size(); i++) {
+      indices[i] = top[i].index;
+      values[i] = top[i].score;
+    }
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("indices", indices);
+    result.Set("scores", values);
+
+    auto found = labels.find(index);
+    if (found != labels.end()) {
+      const std::vector<std::string> &names = found->second;
+      Napi::Array resultLabels = Napi::Array::New(env, top.size());
+      for (size_t i = 0; i < top.size(); i++) {
+        size_t labelIndex = static_cast<size_t>(top[i].index);
+        resultLabels.Set(static_cast<uint32_t>(i), Napi::String::New(
+            env, labelIndex < names.size() ? names[labelIndex] : ""));
+      }
+      result.Set("labels", resultLabels);
+    }
+    return result;
+  }
+
+  static float get_float_option(Napi::Object options, const char *name,
+                               float defaultValue) {
+    Napi::Value value = options.Get(name);
+    return value.IsUndefined() ? defaultValue
+                               : value.ToNumber().FloatValue();
+  }
+
+  /**
+   * setDetection(options: DetectionOptions)
+   *
+   * Configure how detect() decodes the outputs of an SSD style detection
+   * model: which outputs hold the boxes and the class scores, the anchors to
+   * decode boxes relative to, score thresholding, and NMS.
+   */
+  void SetDetection(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsObject()) {
+      throw Napi::TypeError::New(env, "Expected an options object");
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+    std::unique_ptr<DetectionConfig> config(new DetectionConfig());
+    config->boxes = find_output(env, options.Get("boxes"));
+    config->scores = find_output(env, options.Get("scores"));
+
+    postprocessing::DetectionOptions &parsed = config->options;
+    parsed.scoreThreshold = get_float_option(options, "scoreThreshold",
+                                             parsed.scoreThreshold);
+    parsed.iouThreshold = get_float_option(options, "iouThreshold",
+                                           parsed.iouThreshold);
+    parsed.softNmsSigma = get_float_option(options, "softNmsSigma",
+                                           parsed.softNmsSigma);
+    if (parsed.softNmsSigma <= 0) {
+      throw Napi::RangeError::New(env, "'softNmsSigma' must be positive");
+    }
+    Napi::Value maxDetections = options.Get("maxDetections");
+    if (!maxDetections.IsUndefined()) {
+      int64_t value = maxDetections.ToNumber().Int64Value();
+      parsed.maxDetections = value > 0 ? static_cast<size_t>(value) : 0;
+    }
+    Napi::Value nms = options.Get("nms");
+    if (!nms.IsUndefined()) {
+      std::string name = nms.ToString().Utf8Value();
+      if (name != "greedy" && name != "soft") {
+        throw Napi::TypeError::New(env, "Expected 'nms' to be 'greedy' or "
+                                   "'soft'");
+      }
+      parsed.softNms = name == "soft";
+    }
+    parsed.sigmoidScores = options.Get("sigmoid").ToBoolean().Value();
+    parsed.backgroundClass = options.Get("backgroundClass").ToBoolean()
+        .Value();
+
+    Napi::Value anchors = options.Get("anchors");
+    if (!anchors.IsUndefined()) {
+      if (!anchors.IsTypedArray() || anchors.As<Napi::TypedArray>()
+          .TypedArrayType() != napi_float32_array) {
+        throw Napi::TypeError::New(env, "Expected 'anchors' to be a "
+                                   "Float32Array");
+      }
+      Napi::Float32Array values = anchors.As<Napi::Float32Array>();
+      parsed.anchors.assign(values.Data(),
+                            values.Data() + values.ElementLength());
+    }
+    Napi::Value boxScale = options.Get("boxScale");
+    if (!boxScale.IsUndefined()) {
+      if (!boxScale.IsArray() || boxScale.As<Napi::Array>().Length() != 4) {
+        throw Napi::TypeError::New(env, "Expected 'boxScale' to be an array "
+                                   "of 4 numbers");
+      }
+      for (uint32_t i = 0; i < 4; i++) {
+        parsed.boxScale[i] = boxScale.As<Napi::Array>().Get(i).ToNumber()
+            .FloatValue();
+      }
+    }
+    detection = std::move(config);
+  }
+
+  /**
+   * detect(): Float32Array
+   *
+   * Decode the detection outputs configured with setDetection(), reading
+   * them straight from their buffers. Returns 6 values per detection, best
+   * first: yMin, xMin, yMax, xMax, score and class index.
+   */
+  Napi::Value Detect(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throw_if_busy(env);
+    if (!detection) {
+      throw Napi::Error::New(env, "Call setDetection() before detect()");
+    }
+    postprocessing::TensorData boxes =
+        outputTensors[detection->boxes]->getTensorData(env);
+    postprocessing::TensorData scores =
+        outputTensors[detection->scores]->getTensorData(env);
+    size_t numBoxes = boxes.count / 4;
+    if (boxes.count % 4 != 0 || numBoxes == 0
+        || scores.count % numBoxes != 0) {
+      throw Napi::Error::New(env, "Expected 4 box values and the same number "
+                             "of scores for each box");
+    }
+    const postprocessing::DetectionOptions &options = detection->options;
+    if (!options.anchors.empty() && options.anchors.size() != boxes.count) {
+      throw Napi::Error::New(env, "Expected " + std::to_string(boxes.count)
+                             + " anchor values but got "
+                             + std::to_string(options.anchors.size()));
+    }
+
+    std::vector<postprocessing::Detection> detections = postprocessing::detect(
+        boxes, scores, numBoxes, scores.count / numBoxes, options);
+    Napi::Float32Array result = Napi::Float32Array::New(
+        env, detections.size() * 6);
+    float *out = result.Data();
+    for (const postprocessing::Detection &d : detections) {
+      std::copy(d.box, d.box + 4, out);
+      out[4] = d.score;
+      out[5] = static_cast<float>(d.classIndex);
+      out += 6;
+    }
+    return result;
+  }
+
+  /**
+   * resizeInput(index: number, shape: number[])
+   *
+   * Resize an input tensor and reallocate all tensors. Does nothing if the
+   * input already has the given shape. Inputs and outputs whose size changed
+   * get new data arrays, so data arrays obtained before the resize should be
+   * fetched again.
+   */
+  Napi::Value ResizeInput(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    throw_if_busy(env);
+
+    if (!info[0].IsNumber() || !info[1].IsArray()) {
+      throw Napi::TypeError::New(env, "Expected resizeInput(index: number, "
+                                 "shape: number[])");
+    }
+    int32_t index = info[0].As<Napi::Number>().Int32Value();
+    if (index < 0 || index >= (int32_t) inputTensors.size()) {
+      throw Napi::RangeError::New(env, "Input index " + std::to_string(index)
+                                  + " is out of range");
+    }
+
+    Napi::Array shape = info[1].As<Napi::Array>();
+    std::vector<int> dims;
+    for (uint32_t i = 0; i < shape.Length(); i++) {
+      int dim = shape.Get(i).ToNumber().Int32Value();
+      if (dim < 0) {
+        throw Napi::RangeError::New(env, "Invalid dimension "
+                                    + std::to_string(dim) + " in shape");
+      }
+      dims.push_back(dim);
+    }
+
+    if (has_shape(inputTensors[index]->tensor, dims)) {
+      return env.Undefined();
+    }
+
+    if (shapeCacheSize > 0) {
+      switch_shape_plan(env, index, dims);
+      return env.Undefined();
+    }
+
+    std::vector<int> previous;
+    const TfLiteTensor *input = inputTensors[index]->tensor;
+    for (int i = 0; i < TfLiteTensorNumDims(input); i++) {
+      previous.push_back(TfLiteTensorDim(input, i));
+    }
+
+    throw_if_tflite_error(env, "Failed to resize input tensor",
+        TfLiteInterpreterResizeInputTensor(interpreter, index, dims.data(),
+                                           dims.size()));
+    TfLiteStatus status = handle->allocate();
+    if (status != kTfLiteOk) {
+      std::string message = tflite_error_message("Failed to allocate tensors",
+                                                 status);
+      // Go back to the previous shape so the TensorInfos match the tensors
+      // again. They are refreshed either way, since the resize has already
+      // changed the tensors' sizes.
+      TfLiteInterpreterResizeInputTensor(interpreter, index, previous.data(),
+                                         previous.size());
+      handle->allocate();
+      get_and_clear_error_message();
+      refresh_tensors(env);
+      throw Napi::Error::New(env, message);
+    }
+    refresh_tensors(env);
+    return env.Undefined();
+  }
+
+  /**
+   * Make the plan for the current input shapes, with input 'index' resized to
+   * 'dims', the active one. A recently used plan for those shapes is reused
+   * as is. Otherwise a new TFLite interpreter is created for the shared
+   * model. The previously active plan is kept in the LRU 'shapeCache'.
+   */
+  void switch_shape_plan(Napi::Env env, int32_t index,
+                         const std::vector<int> &dims) {
+    std::vector<std::vector<int>> shapes = input_shapes();
+    std::string current_key = shape_key(shapes);
+    shapes[index] = dims;
+    std::string key = shape_key(shapes);
+
+    ShapePlan current = take_plan(current_key);
+
+    auto cached = shapeCache.begin();
+    while (cached != shapeCache.end() && cached->key != key) {
+      cached++;
+    }
+
+    if (cached != shapeCache.end()) {
+      ShapePlan next = std::move(*cached);
+      shapeCache.erase(cached);
+      restore_plan(next);
+    } else {
+      std::shared_ptr<InterpreterHandle> next_handle;
+      try {
+        next_handle = create_allocated_handle(env, shapes);
+      } catch (const Napi::Error &) {
+        restore_plan(current);
+        throw;
+      }
+      handle = next_handle;
+      interpreter = handle->interpreter;
+      // The TensorInfos are unbound, so this creates new data arrays.
+      refresh_tensors(env);
+    }
+
+    shapeCache.push_front(std::move(current));
+    while (shapeCache.size() > shapeCacheSize) {
+      shapeCache.pop_back();
+    }
+  }
+
+  /**
+   * The current shape of every input.
+   */
+  std::vector<std::vector<int>> input_shapes() {
+    std::vector<std::vector<int>> shapes;
+    for (TensorInfo *tensor : inputTensors) {
+      std::vector<int> shape;
+      for (int i = 0; i < TfLiteTensorNumDims(tensor->tensor); i++) {
+        shape.push_back(TfLiteTensorDim(tensor->tensor, i));
+      }
+      shapes.push_back(shape);
+    }
+    return shapes;
+  }
+
+  /**
+   * Create another TFLite interpreter for the shared model, with the inputs
+   * resized to 'shapes' and its tensors allocated.
+   */
+  std::shared_ptr<InterpreterHandle> create_allocated_handle(
+      Napi::Env env, const std::vector<std::vector<int>> &shapes) {
+    std::shared_ptr<InterpreterHandle> next_handle;
+    try {
+      next_handle = create_handle(env, handle->model);
+      for (size_t i = 0; i < shapes.size(); i++) {
+        throw_if_tflite_error(env, "Failed to resize input tensor",
+            TfLiteInterpreterResizeInputTensor(
+                next_handle->interpreter, i, shapes[i].data(),
+                shapes[i].size()));
+      }
+      throw_if_tflite_error(env, "Failed to allocate tensors",
+          next_handle->allocate());
+    } catch (const Napi::Error &e) {
+      // Errors were reported to the new interpreter's error stream.
+      std::string details = next_handle ? next_handle->errorStream.str() : "";
+      throw Napi::Error::New(env, e.Message() + " " + details);
+    }
+    return next_handle;
+  }
+
+  static std::string shape_key(const std::vector<std::vector<int>> &shapes) {
+    std::stringstream key;
+    for (const auto &shape : shapes) {
+      for (int dim : shape) {
+        key << dim << ",";
+      }
+      key << ";";
+    }
+    return key.str();
+  }
+
+  /**
+   * Unbind the TensorInfos from the active interpreter and return them along
+   * with the interpreter as a ShapePlan.
+   */
+  ShapePlan take_plan(const std::string &key) {
+    ShapePlan plan;
+    plan.key = key;
+    plan.handle = handle;
+    for (TensorInfo *tensor : inputTensors) {
+      plan.inputs.push_back(tensor->takeBinding());
+    }
+    for (TensorInfo *tensor : outputTensors) {
+      plan.outputs.push_back(tensor->takeBinding());
+    }
+    return plan;
+  }
+
+  /**
+   * Make 'plan' the active interpreter and bind the TensorInfos to it.
+   */
+  void restore_plan(ShapePlan &plan) {
+    handle = plan.handle;
+    interpreter = handle->interpreter;
+    for (size_t i = 0; i < inputTensors.size(); i++) {
+      inputTensors[i]->restoreBinding(plan.inputs[i]);
+    }
+    for (size_t i = 0; i < outputTensors.size(); i++) {
+      outputTensors[i]->restoreBinding(plan.outputs[i]);
+    }
+  }
+
+  static bool has_shape(const TfLiteTensor *tensor,
+                        const std::vector<int> &dims) {
+    if (TfLiteTensorNumDims(tensor) != (int32_t) dims.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < dims.size(); i++) {
+      if (TfLiteTensorDim(tensor, i) != dims[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Point every TensorInfo at the interpreter's current tensors after they
+   * have been reallocated, rebuilding only the data arrays that no longer fit.
+   */
+  void refresh_tensors(Napi::Env env) {
+    for (size_t i = 0; i < inputTensors.size(); i++) {
+      inputTensors[i]->updateTensor(
+          env, TfLiteInterpreterGetInputTensor(interpreter, i), i,
+          zeroCopy ? handle : nullptr);
+    }
+    for (size_t i = 0; i < outputTensors.size(); i++) {
+      outputTensors[i]->updateTensor(
+          env, TfLiteInterpreterGetOutputTensor(interpreter, i), i,
+          zeroCopy ? handle : nullptr);
+    }
+  }
+};
+
+
+/**
+ * Runs TfLiteInterpreterInvoke on the libuv thread pool.
+ *
+ * Inputs are copied to TFLite on the JavaScript thread before the worker is
+ * queued, so input TensorInfo buffers may be refilled as soon as inferAsync()
+ * returns. Outputs are copied back on the JavaScript thread just before the
+ * promise resolves, so output TensorInfo buffers hold the previous results
+ * until then.
+ *
+ * With zero-copy there are no copies: the data arrays are TFLite's tensor
+ * memory, so data(), setData(), setFromFloat32() and setImage() throw until
+ * the promise settles, and data arrays fetched earlier must not be written.
+ */
+class InferWorker : public Napi::AsyncWorker {
+ public:
+  InferWorker(Napi::Env env, Interpreter *interpreter)
+      : InferWorker(env, interpreter, Napi::Promise::Deferred::New(env)) { }
+
+  InferWorker(Napi::Env env, Interpreter *interpreter,
+              Napi::Promise::Deferred deferred)
+      : Napi::AsyncWorker(env, "tfjs_tflite_node:InferWorker"),
+        interpreter(interpreter),
+        deferred(deferred),
+        threads(interpreter->handle->threads) {
+    // Hold a reference to the interpreter's JS object so it is not garbage
+    // collected while the worker is running.
+    interpreterRef = Napi::Persistent(interpreter->Value());
+  }
+
+  Napi::Promise GetPromise() {
+    return deferred.Promise();
+  }
+
+  /**
+   * Only copy the outputs selected by 'eager' when the invoke completes. The
+   * rest are copied when their data is read.
+   */
+  void SetEagerOutputs(std::vector<bool> eager) {
+    eagerOutputs = eager;
+  }
+
+  /**
+   * Queue the worker once the ThreadBudget has room for the interpreter's
+   * threads.
+   */
+  void QueueWithinBudget() {
+    ThreadBudget::Queue(Env(), this, threads);
+  }
+
+ protected:
+  Interpreter *interpreter;
+  Napi::Promise::Deferred deferred;
+  std::vector<bool> eagerOutputs;
+
+  void Execute() override {
+    ThreadBudget::Admitted budget(threads);
+    status = interpreter->handle->invoke();
+  }
+
+  void OnOK() override {
+    Napi::Env env = Env();
+    Napi::HandleScope scope(env);
+    interpreter->busy = false;
+
+    if (status != kTfLiteOk) {
+      deferred.Reject(Napi::Error::New(env, interpreter->tflite_error_message(
+          "Failed to invoke interpreter", status)).Value());
+    } else {
+      try {
+        deferred.Resolve(GetResult(env));
+      } catch (const Napi::Error &e) {
+        deferred.Reject(e.Value());
+      }
+    }
+    OnSettled(env);
+  }
+
+  void OnError(const Napi::Error &e) override {
+    interpreter->busy = false;
+    deferred.Reject(e.Value());
+    OnSettled(Env());
+  }
+
+  /**
+   * Read the results of a successful invoke. Runs on the JavaScript thread.
+   * The returned value resolves the promise.
+   */
+  virtual Napi::Value GetResult(Napi::Env env) {
+    interpreter->copy_outputs_from_tflite(env, eagerOutputs);
+    return Napi::Boolean::New(env, true);
+  }
+
+  /**
+   * Called on the JavaScript thread after the promise has been settled.
+   */
+  virtual void OnSettled(Napi::Env env) { }
 
-  Napi::Value GetData(const Napi::CallbackInfo &info) {
-    return dataArray.Value();
-  }
+ private:
+  Napi::ObjectReference interpreterRef;
+  // Threads taken from the ThreadBudget while the invoke runs.
+  int threads;
+  TfLiteStatus status = kTfLiteOk;
 };
 
-Napi::FunctionReference TensorInfo::constructor;
+Napi::Value Interpreter::InferAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  throw_if_busy(env);
+  std::vector<bool> eager = parse_output_selection(env, info[0]);
 
-class Interpreter : public Napi::ObjectWrap<Interpreter> {
+  copy_inputs_to_tflite(env);
+
+  // The worker deletes itself after OnOK or OnError runs.
+  InferWorker *worker = new InferWorker(env, this);
+  worker->SetEagerOutputs(eager);
+  busy = true;
+  worker->QueueWithinBudget();
+  return worker->GetPromise();
+}
+
+/**
+ * A fixed set of interpreters over one shared model that serves concurrent
+ * predict() calls. Each call checks out an idle interpreter, runs it on the
+ * libuv thread pool, and returns it to the pool once its outputs have been
+ * read. Calls made while every interpreter is busy wait in a FIFO queue.
+ */
+class InterpreterPool : public Napi::ObjectWrap<InterpreterPool> {
  public:
   static Napi::Object Init(Napi::Env env, Napi::Object exports) {
     Napi::HandleScope scope(env);
-    Napi::Function func = DefineClass(env, "Interpreter", {
-        InstanceMethod<&Interpreter::GetInputs>("getInputs"),
-        InstanceMethod<&Interpreter::GetOutputs>("getOutputs"),
-        InstanceMethod<&Interpreter::Infer>("infer"),
+    Napi::Function func = DefineClass(env, "InterpreterPool", {
+        InstanceAccessor<&InterpreterPool::GetSize>("size"),
+        InstanceAccessor<&InterpreterPool::GetPending>("pending"),
+        InstanceMethod<&InterpreterPool::Predict>("predict"),
       });
-
-    Napi::FunctionReference* constructor = new Napi::FunctionReference();
-
-    // Create a persistent reference to the class constructor. This will allow
-    // a function called on a class prototype and a function
-    // called on instance of a class to be distinguished from each other.
-    *constructor = Napi::Persistent(func);
-    exports.Set("Interpreter", func);
-
+    exports.Set("InterpreterPool", func);
     return exports;
   }
 
-  Interpreter(const Napi::CallbackInfo& info)
-      : Napi::ObjectWrap<Interpreter>(info) {
+  InterpreterPool(const Napi::CallbackInfo& info)
+      : Napi::ObjectWrap<InterpreterPool>(info) {
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
 
-    // Options are an object.
     Napi::Object options = info[1].As<Napi::Object>();
-    interpreterOptions = TfLiteInterpreterOptionsCreate();
-    apply_options(env, options);
-
-    // Create a custom error reporter so JS errors can have meaningful messages.
-    TfLiteInterpreterOptionsSetErrorReporter(interpreterOptions, report_error, &error_stream);
+    uint32_t size = std::thread::hardware_concurrency();
+    auto maybeSize = options.Get("size");
+    if (maybeSize.IsNumber()) {
+      size = maybeSize.ToNumber().Uint32Value();
+    }
+    if (size == 0) {
+      size = 1;
+    }
 
-    // TODO: Throw error on incorrect argument types.
-    // Model is stored as a uint8 buffer.
-    Napi::ArrayBuffer buffer = info[0].As<Napi::ArrayBuffer>();
-    // Create a model from the model buffer.
-    modelData = std::vector<uint8_t>(
-        (uint8_t*) buffer.Data(), (uint8_t*) buffer.Data() + buffer.ByteLength());
-
-    model = TfLiteModelCreate(modelData.data(), modelData.size());
-    if (!model) {
-      TfLiteInterpreterOptionsDelete(interpreterOptions);
-      throw Napi::Error::New(env, "Failed to create tflite model. "
-                             + get_and_clear_error_message());
-    }
-
-    interpreter = TfLiteInterpreterCreate(model, interpreterOptions);
-    if (!interpreter) {
-      TfLiteModelDelete(model);
-      TfLiteInterpreterOptionsDelete(interpreterOptions);
-      throw Napi::Error::New(env, "Failed to create tflite interpreter. "
-                             + get_and_clear_error_message());
+    // Every interpreter is created from the same model argument, so they all
+    // share one TfLiteModel through the ModelRegistry.
+    for (uint32_t i = 0; i < size; i++) {
+      Napi::Object wrapped = AddonData::Get(env)->interpreterConstructor.New(
+          {info[0], options});
+      interpreterRefs.push_back(Napi::Persistent(wrapped));
+      Interpreter *interpreter = Interpreter::Unwrap(wrapped);
+      interpreters.push_back(interpreter);
+      idle.push_back(interpreter);
     }
+  }
 
-    // Allocate tensors
-    throw_if_tflite_error(env, "Failed to allocate tensors",
-                TfLiteInterpreterAllocateTensors(interpreter));
+ private:
+  friend class PoolInferWorker;
 
-    // Get input tensors
-    auto inputs = make_tensors(env, interpreter, /* input? */ true);
-    // Start with a refcount of 1. Otherwise, it will get garbage collected,
-    // since we haven't passed it to JavaScript yet.
-    inputTensorRef = Napi::Reference<Napi::Array>::New(inputs.first, 1);
-    inputTensors = inputs.second;
+  struct Request {
+    std::vector<Napi::Reference<Napi::TypedArray>> inputs;
+    Napi::Promise::Deferred deferred;
+  };
 
-    // Get output tensors
-    auto outputs = make_tensors(env, interpreter, /* input? */ false);
-    outputTensorRef = Napi::Reference<Napi::Array>::New(outputs.first, 1);
-    outputTensors = outputs.second;
-  }
+  std::vector<Interpreter*> interpreters;
+  std::vector<Napi::ObjectReference> interpreterRefs;
+  std::vector<Interpreter*> idle;
+  std::deque<Request> queue;
 
-  Napi::Value GetInputs(const Napi::CallbackInfo& info) {
-    return inputTensorRef.Value();
+  Napi::Value GetSize(const Napi::CallbackInfo &info) {
+    return Napi::Number::New(info.Env(), interpreters.size());
   }
 
-  Napi::Value GetOutputs(const Napi::CallbackInfo& info) {
-    return outputTensorRef.Value();
+  Napi::Value GetPending(const Napi::CallbackInfo &info) {
+    return Napi::Number::New(info.Env(), queue.size());
   }
 
-  ~Interpreter() {
-    inputTensorRef.Unref();
-    outputTensorRef.Unref();
-    TfLiteModelDelete(model);
-    TfLiteInterpreterOptionsDelete(interpreterOptions);
-    TfLiteInterpreterDelete(interpreter);
+  /**
+   * predict(inputs: TypedArray[]): Promise<TypedArray[]>
+   *
+   * Inputs are read when the request is dispatched to an interpreter, so they
+   * must not be modified until the promise settles. Outputs are newly
+   * allocated for each call.
+   */
+  Napi::Value Predict(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    if (!info[0].IsArray()) {
+      throw Napi::TypeError::New(env, "Expected an array of input TypedArrays");
+    }
+    Napi::Array inputs = info[0].As<Napi::Array>();
+
+    Request request{{}, Napi::Promise::Deferred::New(env)};
+    for (uint32_t i = 0; i < inputs.Length(); i++) {
+      Napi::Value input = inputs.Get(i);
+      if (!input.IsTypedArray()) {
+        throw Napi::TypeError::New(env, "Expected input " + std::to_string(i)
+                                   + " to be a TypedArray");
+      }
+      request.inputs.push_back(
+          Napi::Persistent(input.As<Napi::TypedArray>()));
+    }
+    Napi::Promise promise = request.deferred.Promise();
+    queue.push_back(std::move(request));
+    dispatch(env);
+    return promise;
   }
 
- private:
-  TfLiteInterpreter *interpreter = nullptr;
-  TfLiteModel *model = nullptr;
-  TfLiteInterpreterOptions *interpreterOptions = nullptr;
-  std::vector<TensorInfo*> inputTensors;
-  Napi::Reference<Napi::Array> inputTensorRef;
-  std::vector<TensorInfo*> outputTensors;
-  Napi::Reference<Napi::Array> outputTensorRef;
-  std::vector<uint8_t> modelData;
-  std::string delegate_path;
-  std::vector<std::pair<std::string, std::string>> options_strings;
-  std::stringstream error_stream;
+  /**
+   * Start queued requests on idle interpreters.
+   */
+  void dispatch(Napi::Env env);
 
-  void apply_options(Napi::Env &env, Napi::Object &options) {
-    // Set number of threads from options.
-    int threads = 0;
-    auto maybeThreads = options.Get("threads");
-    if (maybeThreads.IsNumber()) {
-      threads = maybeThreads.ToNumber().Int32Value();
-    }
+  void release(Napi::Env env, Interpreter *interpreter) {
+    idle.push_back(interpreter);
+    dispatch(env);
+  }
 
-    if (threads > 0) {
-      TfLiteInterpreterOptionsSetNumThreads(interpreterOptions, threads);
+  /**
+   * Copy a request's inputs directly into the interpreter's TFLite tensors.
+   */
+  static void copy_request_inputs(Napi::Env env, Interpreter *interpreter,
+                                  Request &request) {
+    auto &tensors = interpreter->inputTensors;
+    if (request.inputs.size() != tensors.size()) {
+      throw Napi::Error::New(env, "Expected " + std::to_string(tensors.size())
+                             + " inputs but got "
+                             + std::to_string(request.inputs.size()));
     }
+    for (size_t i = 0; i < tensors.size(); i++) {
+      Napi::TypedArray input = request.inputs[i].Value();
+      TfLiteTensor *tensor = (TfLiteTensor*) tensors[i]->tensor;
+      if (!TensorInfo::matchesTensorType(input.TypedArrayType(), tensor)) {
+        throw Napi::TypeError::New(env, "Input " + std::to_string(i)
+                                   + " does not match the type of tensor '"
+                                   + std::string(TfLiteTensorName(tensor))
+                                   + "'. Expected the type of its data()");
+      }
+      size_t byteSize = TfLiteTensorByteSize(tensor);
+      if (input.ByteLength() != byteSize) {
+        throw Napi::Error::New(env, "Input " + std::to_string(i) + " has "
+                               + std::to_string(input.ByteLength())
+                               + " bytes but the model expects "
+                               + std::to_string(byteSize));
+      }
+      uint8_t *data = (uint8_t*) input.ArrayBuffer().Data()
+          + input.ByteOffset();
+      interpreter->throw_if_tflite_error(
+          env, "Failed to copy input " + std::to_string(i) + " to TFLite",
+          TfLiteTensorCopyFromBuffer(tensor, data, byteSize));
+    }
+  }
+};
 
-    // TODO(mattsoulanille): Support multiple delegates at a time.
-    if (options.Has("delegate")) {
-      auto delegate_config = options.Get("delegate").As<Napi::Object>();
-      delegate_path = delegate_config.Get("path").As<Napi::String>().Utf8Value();
-      auto delegate_options_array = delegate_config.Get("options").As<Napi::Array>();
+/**
+ * Runs one InterpreterPool request. Resolves with fresh copies of the outputs
+ * and hands the interpreter back to the pool.
+ */
+class PoolInferWorker : public InferWorker {
+ public:
+  PoolInferWorker(Napi::Env env, InterpreterPool *pool,
+                  Interpreter *interpreter, Napi::Promise::Deferred deferred)
+      : InferWorker(env, interpreter, deferred), pool(pool) {
+    poolRef = Napi::Persistent(pool->Value());
+  }
 
-      TfLiteExternalDelegateOptions delegate_options =
-          TfLiteExternalDelegateOptionsDefault(delegate_path.c_str());
+ protected:
+  Napi::Value GetResult(Napi::Env env) override {
+    auto &tensors = interpreter->outputTensors;
+    Napi::Array outputs = Napi::Array::New(env, tensors.size());
+    for (size_t i = 0; i < tensors.size(); i++) {
+      const TfLiteTensor *tensor = tensors[i]->tensor;
+      size_t byteSize = TfLiteTensorByteSize(tensor);
+      auto buffer = Napi::ArrayBuffer::New(env, byteSize);
+      interpreter->throw_if_tflite_error(
+          env, "Failed to copy output " + std::to_string(i) + " from TFLite",
+          TfLiteTensorCopyToBuffer(tensor, buffer.Data(), byteSize));
+      outputs.Set((uint32_t) i,
+                  TensorInfo::createTypedArray(env, tensor, buffer));
+    }
+    return outputs;
+  }
 
-      // Options must remain allocated until the interpreter is created, but
-      // options must be inserted as char*. Store options in a vector to keep
-      // them allocated.
-      auto delegate_options_vec = parse_delegate_options(
-          env, delegate_options_array);
-      fill_delegate_options(env, delegate_options, delegate_options_vec);
+  void OnSettled(Napi::Env env) override {
+    pool->release(env, interpreter);
+  }
 
-      TfLiteDelegate* delegate = TfLiteExternalDelegateCreate(&delegate_options);
+ private:
+  InterpreterPool *pool;
+  Napi::ObjectReference poolRef;
+};
 
-      TfLiteInterpreterOptionsAddDelegate(interpreterOptions, delegate);
+void InterpreterPool::dispatch(Napi::Env env) {
+  while (!idle.empty() && !queue.empty()) {
+    Request request = std::move(queue.front());
+    queue.pop_front();
+    Interpreter *interpreter = idle.back();
+    idle.pop_back();
+
+    try {
+      copy_request_inputs(env, interpreter, request);
+    } catch (const Napi::Error &e) {
+      request.deferred.Reject(e.Value());
+      idle.push_back(interpreter);
+      continue;
     }
+
+    PoolInferWorker *worker = new PoolInferWorker(env, this, interpreter,
+                                                  request.deferred);
+    interpreter->busy = true;
+    worker->QueueWithinBudget();
   }
+}
 
-  void fill_delegate_options(
-      Napi::Env &env,
-      TfLiteExternalDelegateOptions &delegate_options,
-      std::vector<std::pair<std::string, std::string>> &options) {
-    for (auto option : options) {
-      auto status = delegate_options.insert(&delegate_options,
-                                            option.first.c_str(),
-                                            option.second.c_str());
-      throw_if_tflite_error(env, "Failed to set delegate options", status);
-    }
+/**
+ * Pipelines inference over several sets of input and output buffers, so the
+ * next frame can be filled and the previous one read while the current one
+ * runs. Frames run on the stream's own interpreters ("stages") for the
+ * runner's model, and copies to and from TFLite happen on the worker thread
+ * along with the invoke. With several stages, one frame's copies overlap
+ * another frame's invoke. When frames arrive faster than they can be run,
+ * the oldest queued frames are dropped.
+ */
+class InferenceStream : public Napi::ObjectWrap<InferenceStream> {
+ public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports) {
+    Napi::HandleScope scope(env);
+    Napi::Function func = DefineClass(env, "InferenceStream", {
+        InstanceMethod<&InferenceStream::NextInputs>("nextInputs"),
+        InstanceMethod<&InferenceStream::Submit>("submit"),
+        InstanceAccessor<&InferenceStream::GetPending>("pending"),
+        InstanceAccessor<&InferenceStream::GetDropped>("dropped"),
+      });
+    exports.Set("InferenceStream", func);
+    return exports;
   }
 
-  std::vector<std::pair<std::string, std::string>> parse_delegate_options(
-      Napi::Env &env, Napi::Array &options) {
+  InferenceStream(const Napi::CallbackInfo& info)
+      : Napi::ObjectWrap<InferenceStream>(info) {
+    Napi::Env env = info.Env();
+    Napi::HandleScope scope(env);
+    if (!info[0].IsObject()
+        || !info[0].As<Napi::Object>().InstanceOf(
+            AddonData::Get(env)->interpreterConstructor.Value())) {
+      throw Napi::TypeError::New(env, "Expected an Interpreter");
+    }
+    Interpreter *interpreter = Interpreter::Unwrap(info[0].As<Napi::Object>());
+    interpreter->throw_if_busy(env);
+
+    uint32_t buffers = 3;
+    uint32_t stageCount = 2;
+    if (info[1].IsObject()) {
+      Napi::Object options = info[1].As<Napi::Object>();
+      auto maybeBuffers = options.Get("buffers");
+      if (maybeBuffers.IsNumber()) {
+        buffers = maybeBuffers.ToNumber().Uint32Value();
+      }
+      auto maybeQueueSize = options.Get("queueSize");
+      if (maybeQueueSize.IsNumber()) {
+        queueSize = maybeQueueSize.ToNumber().Uint32Value();
+      }
+      auto maybeStages = options.Get("stages");
+      if (maybeStages.IsNumber()) {
+        stageCount = maybeStages.ToNumber().Uint32Value();
+      }
+    }
+    if (stageCount < 1) {
+      throw Napi::RangeError::New(env, "'stages' must be at least 1");
+    }
+    // One set more than the stages, so a frame can always be filled.
+    if (buffers < stageCount + 1) {
+      throw Napi::RangeError::New(
+          env, "A stream with " + std::to_string(stageCount) + " stages needs "
+          "at least " + std::to_string(stageCount + 1) + " buffers");
+    }
+    if (queueSize < 1) {
+      throw Napi::RangeError::New(env, "'queueSize' must be at least 1");
+    }
 
-    std::vector<std::pair<std::string, std::string>> options_vec;
-    for (uint32_t i = 0; i < options.Length(); i++) {
-      Napi::Value option = options.Get(i);
-      if (!option.IsArray()) {
-        throw Napi::Error::New(env, "Expected option to be an array but got "
-                               + option.ToString().Utf8Value());
+    std::vector<std::vector<int>> shapes = interpreter->input_shapes();
+    for (uint32_t i = 0; i < stageCount; i++) {
+      stages.emplace_back(new Stage());
+      Stage &stage = *stages.back();
+      stage.handle = interpreter->create_allocated_handle(env, shapes);
+      TfLiteInterpreter *tflite = stage.handle->interpreter;
+      for (int32_t j = 0; j < TfLiteInterpreterGetInputTensorCount(tflite);
+           j++) {
+        stage.inputs.push_back(TfLiteInterpreterGetInputTensor(tflite, j));
+      }
+      for (int32_t j = 0; j < TfLiteInterpreterGetOutputTensorCount(tflite);
+           j++) {
+        stage.outputs.push_back(TfLiteInterpreterGetOutputTensor(tflite, j));
       }
-      Napi::Array as_array = option.As<Napi::Array>();
-      options_vec.push_back(parse_delegate_option(env, as_array));
     }
-    return options_vec;
+    for (uint32_t i = 0; i < buffers; i++) {
+      sets.emplace_back(new BufferSet());
+      BufferSet &set = *sets.back();
+      set.inputs = make_buffers(env, stages[0]->inputs, &set.inputData);
+      set.outputs = make_buffers(env, stages[0]->outputs, &set.outputData);
+    }
   }
 
-  std::pair<std::string, std::string> parse_delegate_option(
-      Napi::Env &env, Napi::Array &option) {
+ private:
+  friend class StreamInferWorker;
 
-    std::pair<std::string, std::string> pair;
-    auto first = option.Get((uint32_t) 0);
-    if (!first.IsString()) {
-      throw Napi::Error::New(env, "Expected option key to be a string but got "
-                       + option.ToString().Utf8Value());
-    }
+  /**
+   * One set of input and output buffers. A set is filled by the caller,
+   * queued, run, and then holds results until it is reused.
+   */
+  struct BufferSet {
+    enum State { kFree, kFilling, kQueued, kRunning, kDone };
+    State state = kFree;
+    // When the set was last submitted, to find the oldest results.
+    uint64_t submitted = 0;
+    Napi::Reference<Napi::Array> inputs;
+    Napi::Reference<Napi::Array> outputs;
+    // The buffers' memory and sizes, for use on the worker thread.
+    std::vector<std::pair<uint8_t*, size_t>> inputData;
+    std::vector<std::pair<uint8_t*, size_t>> outputData;
+  };
 
-    auto second = option.Get((uint32_t) 1);
-    if (!first.IsString()) {
-      throw Napi::Error::New(env, "Expected option value to be a string but got "
-                       + option.ToString().Utf8Value());
+  /**
+   * A TFLite interpreter that runs one frame at a time.
+   */
+  struct Stage {
+    std::shared_ptr<InterpreterHandle> handle;
+    std::vector<TfLiteTensor*> inputs;
+    std::vector<const TfLiteTensor*> outputs;
+    bool running = false;
+  };
+
+  struct Frame {
+    BufferSet *set;
+    Napi::Promise::Deferred deferred;
+  };
+
+  std::vector<std::unique_ptr<Stage>> stages;
+  std::vector<std::unique_ptr<BufferSet>> sets;
+  std::deque<Frame> queue;
+  size_t queueSize = 1;
+  uint64_t submissions = 0;
+  uint64_t dropped = 0;
+
+  template <typename T>
+  static Napi::Reference<Napi::Array> make_buffers(
+      Napi::Env env, const std::vector<T*> &tensors,
+      std::vector<std::pair<uint8_t*, size_t>> *data) {
+    Napi::Array arrays = Napi::Array::New(env, tensors.size());
+    for (size_t i = 0; i < tensors.size(); i++) {
+      size_t byteSize = TfLiteTensorByteSize(tensors[i]);
+      Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, byteSize);
+      data->push_back({static_cast<uint8_t*>(buffer.Data()), byteSize});
+      arrays.Set(static_cast<uint32_t>(i),
+                 TensorInfo::createTypedArray(env, tensors[i], buffer));
     }
+    return Napi::Persistent(arrays);
+  }
 
-    pair.first = first.As<Napi::String>().Utf8Value();
-    pair.second = second.As<Napi::String>().Utf8Value();
-    return pair;
+  Napi::Value GetPending(const Napi::CallbackInfo &info) {
+    return Napi::Number::New(info.Env(), queue.size());
   }
 
-  std::pair<Napi::Array, std::vector<TensorInfo*>> make_tensors(
-      Napi::Env &env, TfLiteInterpreter* interpreter, bool get_inputs) {
-    // Functions to get data from TfLite.
-    int32_t(*get_count)(const TfLiteInterpreter*);
-    TfLiteTensor*(*get_tensor)(const TfLiteInterpreter*, int32_t);
+  Napi::Value GetDropped(const Napi::CallbackInfo &info) {
+    return Napi::Number::New(info.Env(), static_cast<double>(dropped));
+  }
 
-    if (get_inputs) {
-      get_count = &TfLiteInterpreterGetInputTensorCount;
-      get_tensor = &TfLiteInterpreterGetInputTensor;
-    } else {
-      get_count = &TfLiteInterpreterGetOutputTensorCount;
-      // Cast the function type because GetOutputTensor returns const tensors.
-      get_tensor = (TfLiteTensor*(*)(const TfLiteInterpreter*, int32_t))
-                   &TfLiteInterpreterGetOutputTensor;
+  /**
+   * nextInputs(): TypedArray[]
+   *
+   * The input arrays to fill for the next frame. Uses a free buffer set if
+   * there is one, then the set holding the oldest results, and otherwise
+   * drops the oldest queued frame to reuse its set.
+   */
+  Napi::Value NextInputs(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    BufferSet *next = nullptr;
+    for (auto &set : sets) {
+      if (set->state == BufferSet::kFilling) {
+        return set->inputs.Value();
+      }
+      if (set->state == BufferSet::kFree && next == nullptr) {
+        next = set.get();
+      }
     }
-
-    int32_t tensor_count = get_count(interpreter);
-    Napi::Array tensor_array = Napi::Array::New(env, tensor_count);
-    std::vector<TensorInfo*> tensor_vector;
-    for (int id = 0; id < tensor_count; id++) {
-      const TfLiteTensor* tensor = get_tensor(interpreter, id);
-      auto wrapped_tensor_info = TensorInfo::constructor.New({});
-      auto tensor_info = TensorInfo::Unwrap(wrapped_tensor_info);
-      tensor_info->setTensor(env, tensor, id);
-      tensor_array[id] = wrapped_tensor_info;
-      tensor_vector.push_back(tensor_info);
+    if (next == nullptr) {
+      for (auto &set : sets) {
+        if (set->state == BufferSet::kDone
+            && (next == nullptr || set->submitted < next->submitted)) {
+          next = set.get();
+        }
+      }
     }
-    return std::pair<Napi::Array, std::vector<TensorInfo*>>(tensor_array,
-                                                            tensor_vector);
+    if (next == nullptr) {
+      next = drop_oldest(env);
+    }
+    next->state = BufferSet::kFilling;
+    return next->inputs.Value();
   }
 
   /**
-   * This function is passed to tflite as an error reporter. It appends
-   * errors to the stringstream passed to it as error_stream.
+   * submit(): Promise<TypedArray[]|null>
+   *
+   * Queue the frame filled through nextInputs(). Resolves with the frame's
+   * output arrays, or with null if the frame was dropped. The output arrays
+   * belong to the buffer set, so read them before it is reused.
    */
-  static void report_error(void* error_stream, const char* format, va_list args) {
-    std::stringstream *err = (std::stringstream*) error_stream;
-    char err_message_buffer[MAX_ERROR_LEN];
-    std::vsnprintf(err_message_buffer, MAX_ERROR_LEN, format, args);
-    *err << err_message_buffer << std::endl;
+  Napi::Value Submit(const Napi::CallbackInfo &info) {
+    Napi::Env env = info.Env();
+    BufferSet *filled = nullptr;
+    for (auto &set : sets) {
+      if (set->state == BufferSet::kFilling) {
+        filled = set.get();
+      }
+    }
+    if (filled == nullptr) {
+      throw Napi::Error::New(env, "Call nextInputs() and fill the inputs "
+                             "before submitting a frame");
+    }
+    filled->state = BufferSet::kQueued;
+    filled->submitted = ++submissions;
+    Frame frame{filled, Napi::Promise::Deferred::New(env)};
+    Napi::Promise promise = frame.deferred.Promise();
+    queue.push_back(frame);
+    while (queue.size() > queueSize) {
+      drop_oldest(env)->state = BufferSet::kFree;
+    }
+    dispatch(env);
+    return promise;
   }
 
   /**
-   * Get the error messages reported by 'report_error' and clear the error
-   * stream.
+   * Drop the oldest queued frame, resolving it with null, and return its
+   * buffer set.
    */
-  std::string get_and_clear_error_message() {
-    std::string error_message = error_stream.str();
-    error_stream.str(std::string());
-    return error_message;
+  BufferSet *drop_oldest(Napi::Env env) {
+    Frame frame = queue.front();
+    queue.pop_front();
+    dropped++;
+    frame.deferred.Resolve(env.Null());
+    return frame.set;
   }
 
   /**
-   * Throw an error if the TfLiteStatus is not okay. Includes the 'message' in
-   * error and appends a description of the TfLite error along with any error
-   * messages reported by TfLite.
+   * Run the oldest queued frames on the idle stages.
    */
-  void throw_if_tflite_error(Napi::Env &env, std::string message, TfLiteStatus status) {
-    if (status != kTfLiteOk) {
-      throw Napi::Error::New(env, message + ": " + decodeStatus(status) + ". "
-                             + get_and_clear_error_message());
-    }
+  void dispatch(Napi::Env env);
+
+  void finish(Napi::Env env, Stage *stage) {
+    stage->running = false;
+    dispatch(env);
   }
+};
 
-  Napi::Value Infer(const Napi::CallbackInfo &info) {
-    Napi::Env env = info.Env();
+/**
+ * Runs one InferenceStream frame on one of its stages: copies its inputs to
+ * TFLite, invokes, and copies the outputs into the frame's output buffers,
+ * all off the JavaScript thread.
+ */
+class StreamInferWorker : public Napi::AsyncWorker {
+ public:
+  StreamInferWorker(Napi::Env env, InferenceStream *stream,
+                    InferenceStream::Frame frame, InferenceStream::Stage *stage)
+      : Napi::AsyncWorker(env, "tfjs_tflite_node:StreamInferWorker"),
+        stream(stream),
+        frame(frame),
+        stage(stage) {
+    streamRef = Napi::Persistent(stream->Value());
+  }
 
-    for (TensorInfo* tensor : inputTensors) {
-      tensor->copyToTflite(env);
+ protected:
+  void Execute() override {
+    ThreadBudget::Admitted budget(stage->handle->threads);
+    BufferSet &set = *frame.set;
+    for (size_t i = 0; i < stage->inputs.size(); i++) {
+      if (!check(TfLiteTensorCopyFromBuffer(stage->inputs[i],
+                                            set.inputData[i].first,
+                                            set.inputData[i].second),
+                 "copy input " + std::to_string(i) + " to TFLite")) {
+        return;
+      }
+    }
+    TfLiteStatus status = stage->handle->invoke();
+    budget.Release();
+    if (!check(status, "invoke interpreter")) {
+      return;
+    }
+    for (size_t i = 0; i < stage->outputs.size(); i++) {
+      if (!check(TfLiteTensorCopyToBuffer(stage->outputs[i],
+                                          set.outputData[i].first,
+                                          set.outputData[i].second),
+                 "copy output " + std::to_string(i) + " from TFLite")) {
+        return;
+      }
     }
+  }
 
-    throw_if_tflite_error(env, "Failed to invoke interpreter",
-                          TfLiteInterpreterInvoke(interpreter));
+  void OnOK() override {
+    Napi::Env env = Env();
+    Napi::HandleScope scope(env);
+    frame.set->state = InferenceStream::BufferSet::kDone;
+    frame.deferred.Resolve(frame.set->outputs.Value());
+    stream->finish(env, stage);
+  }
 
-    for (TensorInfo* tensor : outputTensors) {
-      tensor->copyFromTflite(env);
-    }
+  void OnError(const Napi::Error &e) override {
+    Napi::Env env = Env();
+    frame.set->state = InferenceStream::BufferSet::kFree;
+    frame.deferred.Reject(e.Value());
+    stream->finish(env, stage);
+  }
 
-    return Napi::Boolean::New(env, true);
+ private:
+  typedef InferenceStream::BufferSet BufferSet;
+  InferenceStream *stream;
+  Napi::ObjectReference streamRef;
+  InferenceStream::Frame frame;
+  InferenceStream::Stage *stage;
+
+  bool check(TfLiteStatus status, const std::string &step) {
+    if (status != kTfLiteOk) {
+      // Only this worker uses the stage's error stream until it completes.
+      std::stringstream &errors = stage->handle->errorStream;
+      SetError("Failed to " + step + ": " + decodeStatus(status) + ". "
+               + errors.str());
+      errors.str(std::string());
+      return false;
+    }
+    return true;
   }
 };
 
+void InferenceStream::dispatch(Napi::Env env) {
+  for (auto &stage : stages) {
+    if (queue.empty()) {
+      return;
+    }
+    if (stage->running) {
+      continue;
+    }
+    Frame frame = queue.front();
+    queue.pop_front();
+    frame.set->state = BufferSet::kRunning;
+    stage->running = true;
+    // The worker deletes itself after OnOK or OnError runs.
+    StreamInferWorker *worker = new StreamInferWorker(env, this, frame,
+                                                      stage.get());
+    ThreadBudget::Queue(env, worker, stage->handle->threads);
+  }
+}
+
+/**
+ * Cap the threads running inference at once across the process. Zero removes
+ * the cap.
+ */
+Napi::Value SetThreadBudget(const Napi::CallbackInfo &info) {
+  if (!info[0].IsNumber() || info[0].As<Napi::Number>().Int32Value() < 0) {
+    throw Napi::TypeError::New(info.Env(), "Expected a thread count of 0 or "
+                               "more");
+  }
+  ThreadBudget::SetLimit(info[0].As<Napi::Number>().Int32Value());
+  return info.Env().Undefined();
+}
+
+Napi::Value GetThreadBudget(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  ThreadBudget::Stats stats = ThreadBudget::GetStats();
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("limit", Napi::Number::New(env, stats.limit));
+  result.Set("running", Napi::Number::New(env, stats.running));
+  result.Set("waiting", Napi::Number::New(env, stats.waiting));
+  result.Set("interpreters", Napi::Number::New(env, stats.interpreters));
+  result.Set("threads", Napi::Number::New(env, stats.threads));
+  return result;
+}
+
+/**
+ * Process-wide counts of delegate cache lookups that found serialized data
+ * for their model token, and those that did not.
+ */
+Napi::Value GetDelegateCacheStats(const Napi::CallbackInfo &info) {
+  Napi::Object stats = Napi::Object::New(info.Env());
+  stats.Set("hits", Napi::Number::New(
+      info.Env(), static_cast<double>(DelegateCache::Hits())));
+  stats.Set("misses", Napi::Number::New(
+      info.Env(), static_cast<double>(DelegateCache::Misses())));
+  return stats;
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
+  // Deleted, along with its references, when the environment shuts down.
+  env.SetInstanceData(new AddonData(env));
   Interpreter::Init(env, exports);
   TensorInfo::Init(env, exports);
+  InterpreterPool::Init(env, exports);
+  InferenceStream::Init(env, exports);
+  exports.Set("simdLevel",
+              Napi::String::New(env, tensor_conversion::simdLevel()));
+  exports.Set("imageDecoding",
+              Napi::Boolean::New(env, image_decoding::isSupported()));
+#ifdef TFLITE_NODE_XNNPACK
+  exports.Set("xnnpack", Napi::Boolean::New(env, true));
+#else
+  exports.Set("xnnpack", Napi::Boolean::New(env, false));
+#endif
+  exports.Set("threadAffinity",
+              Napi::Boolean::New(env, thread_affinity::isSupported()));
+  exports.Set("setThreadBudget", Napi::Function::New(env, SetThreadBudget));
+  exports.Set("threadBudget", Napi::Function::New(env, GetThreadBudget));
+  exports.Set("delegateCacheStats",
+              Napi::Function::New(env, GetDelegateCacheStats));
 
   return exports;
 }
@@ -0,0 +1,344 @@
+/**
+ * @license
+ * Copyright 2022 Google LLC. All Rights Reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * =============================================================================
+ */
+
+#include "postprocessing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TFJS_POSTPROCESSING_X86 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define TFJS_POSTPROCESSING_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace postprocessing {
+namespace {
+
+// Scores that are not float32 are converted this many at a time.
+const size_t kBlockSize = 1024;
+
+/**
+ * Whether any of the 8 values at 'values' is greater than 'threshold'.
+ */
+inline bool anyGreater(const float *values, float threshold) {
+#if defined(TFJS_POSTPROCESSING_X86)
+  __m128 t = _mm_set1_ps(threshold);
+  __m128 greater = _mm_or_ps(_mm_cmpgt_ps(_mm_loadu_ps(values), t),
+                             _mm_cmpgt_ps(_mm_loadu_ps(values + 4), t));
+  return _mm_movemask_ps(greater) != 0;
+#elif defined(TFJS_POSTPROCESSING_NEON)
+  float32x4_t t = vdupq_n_f32(threshold);
+  uint32x4_t greater = vorrq_u32(vcgtq_f32(vld1q_f32(values), t),
+                                 vcgtq_f32(vld1q_f32(values + 4), t));
+  return vmaxvq_u32(greater) != 0;
+#else
+  for (int i = 0; i < 8; i++) {
+    if (values[i] > threshold) {
+      return true;
+    }
+  }
+  return false;
+#endif
+}
+
+/**
+ * Read 'count' values starting at index 'start' as floats, dequantizing
+ * integer types.
+ */
+void readFloats(const TensorData &tensor, size_t start, size_t count,
+                float *out) {
+  const uint8_t *source = static_cast<const uint8_t*>(tensor.data)
+      + start * tensor_conversion::elementSize(tensor.type);
+  // Only integer types are dequantized. Others are just converted.
+  if (!tensor_conversion::dequantizeToFloat32(source, tensor.type, out,
+                                              tensor.scale, tensor.zeroPoint,
+                                              count)) {
+    tensor_conversion::convertElements(source, tensor.type, out,
+                                       tensor_conversion::kFloat32, count);
+  }
+}
+
+/**
+ * Call 'visit(values, count, start)' for consecutive blocks of the tensor's
+ * values as floats. float32 tensors are visited in one block, in place.
+ */
+template <typename Visitor>
+void forEachBlock(const TensorData &tensor, Visitor visit) {
+  if (tensor.type == tensor_conversion::kFloat32) {
+    visit(static_cast<const float*>(tensor.data), tensor.count, 0);
+    return;
+  }
+  std::vector<float> block(std::min(kBlockSize, tensor.count));
+  for (size_t start = 0; start < tensor.count; start += kBlockSize) {
+    size_t count = std::min(kBlockSize, tensor.count - start);
+    readFloats(tensor, start, count, block.data());
+    visit(static_cast<const float*>(block.data()), count, start);
+  }
+}
+
+/**
+ * True if 'a' ranks above 'b'.
+ */
+inline bool ranksAbove(const ScoredIndex &a, const ScoredIndex &b) {
+  return a.score > b.score || (a.score == b.score && a.index < b.index);
+}
+
+/**
+ * Keeps the k best scores seen so far in a heap with the worst of them on
+ * top, so a new score only has to beat the top to get in.
+ */
+class TopKHeap {
+ public:
+  explicit TopKHeap(size_t k) : k(k) {
+    heap.reserve(k);
+  }
+
+  /**
+   * Add the scores of indices 'firstIndex' to 'firstIndex + count - 1'.
+   */
+  void add(const float *values, size_t count, size_t firstIndex) {
+    size_t i = 0;
+    // Fill the heap first. Nothing can be skipped until it is full.
+    for (; i < count && heap.size() < k; i++) {
+      if (!std::isnan(values[i])) {
+        heap.push_back({static_cast<int32_t>(firstIndex + i), values[i]});
+        std::push_heap(heap.begin(), heap.end(), ranksAbove);
+      }
+    }
+    if (heap.empty()) {
+      return;
+    }
+    for (; i + 8 <= count; i += 8) {
+      // Scores equal to the worst one kept lose to it on index.
+      if (anyGreater(values + i, heap.front().score)) {
+        for (size_t j = i; j < i + 8; j++) {
+          offer(values[j], firstIndex + j);
+        }
+      }
+    }
+    for (; i < count; i++) {
+      offer(values[i], firstIndex + i);
+    }
+  }
+
+  /**
+   * The kept scores, best first.
+   */
+  std::vector<ScoredIndex> take() {
+    std::sort_heap(heap.begin(), heap.end(), ranksAbove);
+    return std::move(heap);
+  }
+
+ private:
+  size_t k;
+  std::vector<ScoredIndex> heap;
+
+  void offer(float score, size_t index) {
+    if (score > heap.front().score) {
+      std::pop_heap(heap.begin(), heap.end(), ranksAbove);
+      heap.back() = {static_cast<int32_t>(index), score};
+      std::push_heap(heap.begin(), heap.end(), ranksAbove);
+    }
+  }
+};
+
+}  // namespace
+
+std::vector<ScoredIndex> topK(const TensorData &scores, size_t k) {
+  k = std::min(k, scores.count);
+  TopKHeap heap(k);
+  if (k == 0) {
+    return heap.take();
+  }
+  forEachBlock(scores, [&](const float *values, size_t count, size_t start) {
+    heap.add(values, count, start);
+  });
+  return heap.take();
+}
+
+namespace {
+
+float sigmoid(float x) {
+  return 1 / (1 + std::exp(-x));
+}
+
+/**
+ * The score threshold on logits that matches 'threshold' after the sigmoid.
+ */
+float logit(float threshold) {
+  if (threshold <= 0) {
+    return -std::numeric_limits<float>::infinity();
+  }
+  if (threshold >= 1) {
+    return std::numeric_limits<float>::infinity();
+  }
+  return std::log(threshold / (1 - threshold));
+}
+
+float intersectionOverUnion(const Detection &a, const Detection &b) {
+  float aYMin = std::min(a.box[0], a.box[2]);
+  float aYMax = std::max(a.box[0], a.box[2]);
+  float aXMin = std::min(a.box[1], a.box[3]);
+  float aXMax = std::max(a.box[1], a.box[3]);
+  float bYMin = std::min(b.box[0], b.box[2]);
+  float bYMax = std::max(b.box[0], b.box[2]);
+  float bXMin = std::min(b.box[1], b.box[3]);
+  float bXMax = std::max(b.box[1], b.box[3]);
+  float aArea = (aYMax - aYMin) * (aXMax - aXMin);
+  float bArea = (bYMax - bYMin) * (bXMax - bXMin);
+  if (aArea <= 0 || bArea <= 0) {
+    return 0;
+  }
+  float height = std::max(0.0f, std::min(aYMax, bYMax)
+                          - std::max(aYMin, bYMin));
+  float width = std::max(0.0f, std::min(aXMax, bXMax)
+                         - std::max(aXMin, bXMin));
+  float intersection = height * width;
+  return intersection / (aArea + bArea - intersection);
+}
+
+void decodeBox(const TensorData &boxes, size_t index,
+               const DetectionOptions &options, float *box) {
+  float encoded[4];
+  readFloats(boxes, index * 4, 4, encoded);
+  if (options.anchors.empty()) {
+    std::copy(encoded, encoded + 4, box);
+    return;
+  }
+  const float *anchor = &options.anchors[index * 4];
+  float yCenter = encoded[0] / options.boxScale[0] * anchor[2] + anchor[0];
+  float xCenter = encoded[1] / options.boxScale[1] * anchor[3] + anchor[1];
+  float halfHeight = std::exp(encoded[2] / options.boxScale[2]) * anchor[2]
+      / 2;
+  float halfWidth = std::exp(encoded[3] / options.boxScale[3]) * anchor[3]
+      / 2;
+  box[0] = yCenter - halfHeight;
+  box[1] = xCenter - halfWidth;
+  box[2] = yCenter + halfHeight;
+  box[3] = xCenter + halfWidth;
+}
+
+bool detectionRanksAbove(const Detection &a, const Detection &b) {
+  return a.score > b.score;
+}
+
+std::vector<Detection> greedyNms(const std::vector<Detection> &candidates,
+                                 const DetectionOptions &options) {
+  std::vector<Detection> selected;
+  for (const Detection &candidate : candidates) {
+    if (selected.size() >= options.maxDetections) {
+      break;
+    }
+    bool suppressed = false;
+    for (const Detection &kept : selected) {
+      if (intersectionOverUnion(candidate, kept) > options.iouThreshold) {
+        suppressed = true;
+        break;
+      }
+    }
+    if (!suppressed) {
+      selected.push_back(candidate);
+    }
+  }
+  return selected;
+}
+
+std::vector<Detection> softNms(std::vector<Detection> candidates,
+                               const DetectionOptions &options) {
+  std::vector<Detection> selected;
+  while (!candidates.empty() && selected.size() < options.maxDetections) {
+    auto best = std::max_element(candidates.begin(), candidates.end(),
+                                 [](const Detection &a, const Detection &b) {
+                                   return a.score < b.score;
+                                 });
+    if (best->score <= options.scoreThreshold) {
+      break;
+    }
+    selected.push_back(*best);
+    candidates.erase(best);
+    const Detection &kept = selected.back();
+    for (Detection &candidate : candidates) {
+      float iou = intersectionOverUnion(candidate, kept);
+      candidate.score *= std::exp(-iou * iou / options.softNmsSigma);
+    }
+  }
+  return selected;
+}
+
+}  // namespace
+
+std::vector<Detection> detect(const TensorData &boxes,
+                              const TensorData &scores, size_t numBoxes,
+                              size_t numClasses,
+                              const DetectionOptions &options) {
+  float threshold = options.sigmoidScores ? logit(options.scoreThreshold)
+                                          : options.scoreThreshold;
+  size_t firstClass = options.backgroundClass ? 1 : 0;
+
+  // The best class of each box that has a score above the threshold.
+  std::vector<float> bestScores(numBoxes,
+                                -std::numeric_limits<float>::infinity());
+  std::vector<int32_t> bestClasses(numBoxes, -1);
+  auto consider = [&](float score, size_t index) {
+    size_t box = index / numClasses;
+    size_t classIndex = index % numClasses;
+    if (score > threshold && classIndex >= firstClass
+        && score > bestScores[box]) {
+      bestScores[box] = score;
+      bestClasses[box] = static_cast<int32_t>(classIndex);
+    }
+  };
+  forEachBlock(scores, [&](const float *values, size_t count, size_t start) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+      // Most scores of most boxes are below the threshold.
+      if (anyGreater(values + i, threshold)) {
+        for (size_t j = i; j < i + 8; j++) {
+          consider(values[j], start + j);
+        }
+      }
+    }
+    for (; i < count; i++) {
+      consider(values[i], start + i);
+    }
+  });
+
+  std::vector<Detection> candidates;
+  for (size_t box = 0; box < numBoxes; box++) {
+    if (bestClasses[box] < 0) {
+      continue;
+    }
+    Detection detection;
+    decodeBox(boxes, box, options, detection.box);
+    detection.score = options.sigmoidScores ? sigmoid(bestScores[box])
+                                            : bestScores[box];
+    detection.classIndex = bestClasses[box];
+    candidates.push_back(detection);
+  }
+
+  if (options.softNms) {
+    return softNms(std::move(candidates), options);
+  }
+  std::stable_sort(candidates.begin(), candidates.end(), detectionRanksAbove);
+  return greedyNms(candidates, options);
+}
+
+}  // namespace postprocessing
@@ -0,0 +1,97 @@
+/**
+ * @license
+ * Copyright 2022 Google LLC. All Rights Reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * =============================================================================
+ */
+
+#ifndef TFJS_TFLITE_NODE_POSTPROCESSING_H_
+#define TFJS_TFLITE_NODE_POSTPROCESSING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tensor_conversion.h"
+
+namespace postprocessing {
+
+/**
+ * Values in a tensor's buffer. Integer values are dequantized with 'scale'
+ * and 'zeroPoint', which are 1 and 0 for tensors that are not quantized.
+ */
+struct TensorData {
+  const void *data;
+  tensor_conversion::ElementType type;
+  size_t count;
+  float scale;
+  int32_t zeroPoint;
+};
+
+struct ScoredIndex {
+  int32_t index;
+  float score;
+};
+
+/**
+ * The 'k' highest scores and their indices, highest first. Equal scores are
+ * ordered by index, and NaN scores are never picked. The scores are
+ * dequantized a block at a time, and blocks are skipped with SIMD
+ * comparisons once none of their scores can make it into the top k.
+ */
+std::vector<ScoredIndex> topK(const TensorData &scores, size_t k);
+
+struct DetectionOptions {
+  // Boxes whose best class score is not above this are dropped before NMS.
+  float scoreThreshold = 0.5f;
+  // Greedy NMS drops boxes that overlap a better one by more than this.
+  float iouThreshold = 0.5f;
+  size_t maxDetections = 100;
+  // Gaussian soft NMS decays the scores of overlapping boxes by
+  // exp(-iou^2 / softNmsSigma) instead of dropping them.
+  bool softNms = false;
+  float softNmsSigma = 0.5f;
+  // Scores are logits to be passed through a sigmoid. Thresholding is done
+  // on the logits, so only kept scores pay for the exp().
+  bool sigmoidScores = false;
+  // Class 0 is a background class that is never detected.
+  bool backgroundClass = false;
+  // SSD anchors as (yCenter, xCenter, height, width), 4 values per box. If
+  // empty, boxes are already decoded as (yMin, xMin, yMax, xMax).
+  std::vector<float> anchors;
+  // Divisors of the (y, x, height, width) box encodings relative to anchors.
+  float boxScale[4] = {10, 10, 5, 5};
+};
+
+struct Detection {
+  // yMin, xMin, yMax, xMax.
+  float box[4];
+  float score;
+  int32_t classIndex;
+};
+
+/**
+ * Decode SSD style detections: 'boxes' holds 4 values per box and 'scores'
+ * 'numClasses' scores per box. Each box gets its best class, boxes above the
+ * score threshold are decoded, and NMS picks at most maxDetections of them,
+ * best first. Blocks of scores below the threshold are skipped with SIMD
+ * comparisons, and only the boxes that pass are decoded.
+ */
+std::vector<Detection> detect(const TensorData &boxes,
+                              const TensorData &scores, size_t numBoxes,
+                              size_t numClasses,
+                              const DetectionOptions &options);
+
+}  // namespace postprocessing
+
+#endif  // TFJS_TFLITE_NODE_POSTPROCESSING_H_
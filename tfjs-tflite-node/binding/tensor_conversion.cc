@@ -0,0 +1,1420 @@
+/**
+ * @license
+ * Copyright 2022 Google LLC. All Rights Reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * =============================================================================
+ */
+
+#include "tensor_conversion.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TFJS_CONVERSION_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles AVX2 and F16C intrinsics without any extra flags.
+#define TFJS_TARGET_AVX2
+#define TFJS_TARGET_F16C
+#else
+#include <cpuid.h>
+#define TFJS_TARGET_AVX2 __attribute__((target("avx2")))
+#define TFJS_TARGET_F16C __attribute__((target("avx,f16c")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define TFJS_CONVERSION_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace tensor_conversion {
+namespace {
+
+typedef void (*Kernel)(const void *src, void *dst, size_t count);
+typedef void (*QuantizeKernel)(const float *src, void *dst, float scale,
+                               int32_t zeroPoint, size_t count);
+typedef void (*DequantizeKernel)(const void *src, float *dst, float scale,
+                                 int32_t zeroPoint, size_t count);
+
+/**
+ * Wrap a float to 32 bits the way JS ToInt32 / ToUint32 do. The result can be
+ * truncated further to 8 or 16 bits, since those divide 2^32.
+ */
+inline uint32_t wrapToUint32(double value) {
+  if (!std::isfinite(value)) {
+    return 0;
+  }
+  double wrapped = std::fmod(std::trunc(value), 4294967296.0);
+  if (wrapped < 0) {
+    wrapped += 4294967296.0;
+  }
+  return static_cast<uint32_t>(wrapped);
+}
+
+// Integer to integer: keep the low bits.
+template <typename D, typename S>
+inline D castElement(S value, std::true_type, std::true_type) {
+  return static_cast<D>(value);
+}
+
+// Float to integer.
+template <typename D, typename S>
+inline D castElement(S value, std::true_type, std::false_type) {
+  return static_cast<D>(wrapToUint32(value));
+}
+
+// Anything to float.
+template <typename D, typename S, typename SourceIsIntegral>
+inline D castElement(S value, std::false_type, SourceIsIntegral) {
+  return static_cast<D>(value);
+}
+
+template <typename S, typename D>
+void convertScalar(const void *src, void *dst, size_t count) {
+  const S *s = static_cast<const S*>(src);
+  D *d = static_cast<D*>(dst);
+  for (size_t i = 0; i < count; i++) {
+    d[i] = castElement<D>(s[i], std::is_integral<D>(), std::is_integral<S>());
+  }
+}
+
+template <typename S>
+void convertScalarToBool(const void *src, void *dst, size_t count) {
+  const S *s = static_cast<const S*>(src);
+  uint8_t *d = static_cast<uint8_t*>(dst);
+  for (size_t i = 0; i < count; i++) {
+    // 's[i] == s[i]' is false for NaN.
+    d[i] = (s[i] != 0 && s[i] == s[i]) ? 1 : 0;
+  }
+}
+
+template <typename S>
+Kernel scalarKernelFrom(ElementType to) {
+  switch (to) {
+    case kInt8: return convertScalar<S, int8_t>;
+    case kUint8: return convertScalar<S, uint8_t>;
+    case kInt16: return convertScalar<S, int16_t>;
+    case kUint16: return convertScalar<S, uint16_t>;
+    case kInt32: return convertScalar<S, int32_t>;
+    case kUint32: return convertScalar<S, uint32_t>;
+    case kFloat32: return convertScalar<S, float>;
+    case kFloat64: return convertScalar<S, double>;
+    case kBool: return convertScalarToBool<S>;
+    // Converted through float32 by convertElements().
+    case kFloat16: return nullptr;
+  }
+  return nullptr;
+}
+
+Kernel scalarKernel(ElementType from, ElementType to) {
+  switch (from) {
+    case kInt8: return scalarKernelFrom<int8_t>(to);
+    case kUint8: return scalarKernelFrom<uint8_t>(to);
+    case kInt16: return scalarKernelFrom<int16_t>(to);
+    case kUint16: return scalarKernelFrom<uint16_t>(to);
+    case kInt32: return scalarKernelFrom<int32_t>(to);
+    case kUint32: return scalarKernelFrom<uint32_t>(to);
+    case kFloat32: return scalarKernelFrom<float>(to);
+    case kFloat64: return scalarKernelFrom<double>(to);
+    case kBool: return scalarKernelFrom<uint8_t>(to);
+    case kFloat16: return nullptr;
+  }
+  return nullptr;
+}
+
+inline uint32_t floatBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline float bitsToFloat(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * Convert a float to IEEE half precision bits, rounding to nearest even like
+ * the F16C and NEON instructions do. NaNs stay NaN and keep the top bits of
+ * their payload.
+ */
+inline uint16_t floatToHalf(float value) {
+  uint32_t bits = floatBits(value);
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t magnitude = bits & 0x7FFFFFFF;
+  if (magnitude >= 0x7F800000) {
+    // Infinity stays infinity, NaN becomes a quiet NaN.
+    return static_cast<uint16_t>(
+        sign | 0x7C00 |
+        (magnitude > 0x7F800000 ? 0x200 | ((magnitude >> 13) & 0x3FF) : 0));
+  }
+  if (magnitude >= 0x477FF000) {
+    // At least 65520, which rounds to infinity.
+    return static_cast<uint16_t>(sign | 0x7C00);
+  }
+  if (magnitude < 0x38800000) {
+    // Below the smallest normal half, 2^-14. Adding 0.5 lines the half's
+    // subnormal bits up with the bottom of the float's mantissa, and lets
+    // the FPU do the rounding.
+    float shifted = bitsToFloat(magnitude) + 0.5f;
+    return static_cast<uint16_t>(sign | (floatBits(shifted) - 0x3F000000));
+  }
+  // Rebias the exponent and round the mantissa to nearest even.
+  uint32_t odd = (magnitude >> 13) & 1;
+  magnitude += 0xC8000FFF + odd;  // -(112 << 23) + 0xFFF, modulo 2^32.
+  return static_cast<uint16_t>(sign | (magnitude >> 13));
+}
+
+inline float halfToFloat(uint16_t half) {
+  uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1F;
+  uint32_t mantissa = half & 0x3FF;
+  if (exponent == 0) {
+    // Zero or subnormal: mantissa * 2^-24, which is exact in float.
+    return bitsToFloat(sign | floatBits(mantissa * 5.9604644775390625e-8f));
+  }
+  if (exponent == 31) {
+    // Infinity, or NaN made quiet as the hardware conversions do.
+    uint32_t quiet = mantissa != 0 ? 0x400000 : 0;
+    return bitsToFloat(sign | 0x7F800000 | quiet | (mantissa << 13));
+  }
+  return bitsToFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+void float16ToFloat32Scalar(const void *src, void *dst, size_t count) {
+  const uint16_t *s = static_cast<const uint16_t*>(src);
+  float *d = static_cast<float*>(dst);
+  for (size_t i = 0; i < count; i++) {
+    d[i] = halfToFloat(s[i]);
+  }
+}
+
+void float32ToFloat16Scalar(const void *src, void *dst, size_t count) {
+  const float *s = static_cast<const float*>(src);
+  uint16_t *d = static_cast<uint16_t*>(dst);
+  for (size_t i = 0; i < count; i++) {
+    d[i] = floatToHalf(s[i]);
+  }
+}
+
+/**
+ * Quantize as TFLite does: divide by the scale, round half away from zero,
+ * add the zero point and clamp to the type's range. Clamping happens before
+ * rounding, which gives the same result since the bounds are integers, and
+ * maps NaN to the type's minimum like the vector kernels do.
+ */
+template <typename Q>
+void quantizeScalar(const float *src, void *dst, float scale,
+                    int32_t zeroPoint, size_t count) {
+  Q *d = static_cast<Q*>(dst);
+  const double lo = static_cast<double>(std::numeric_limits<Q>::min())
+      - zeroPoint;
+  const double hi = static_cast<double>(std::numeric_limits<Q>::max())
+      - zeroPoint;
+  for (size_t i = 0; i < count; i++) {
+    double v = src[i] / scale;
+    v = v > lo ? v : lo;
+    v = v < hi ? v : hi;
+    d[i] = static_cast<Q>(static_cast<int64_t>(std::round(v)) + zeroPoint);
+  }
+}
+
+template <typename Q>
+void dequantizeScalar(const void *src, float *dst, float scale,
+                      int32_t zeroPoint, size_t count) {
+  const Q *s = static_cast<const Q*>(src);
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = static_cast<float>(static_cast<int64_t>(s[i]) - zeroPoint)
+        * scale;
+  }
+}
+
+QuantizeKernel scalarQuantizeKernel(ElementType to) {
+  switch (to) {
+    case kInt8: return quantizeScalar<int8_t>;
+    case kUint8: return quantizeScalar<uint8_t>;
+    case kInt16: return quantizeScalar<int16_t>;
+    case kUint16: return quantizeScalar<uint16_t>;
+    case kInt32: return quantizeScalar<int32_t>;
+    case kUint32: return quantizeScalar<uint32_t>;
+    default: return nullptr;
+  }
+}
+
+DequantizeKernel scalarDequantizeKernel(ElementType from) {
+  switch (from) {
+    case kInt8: return dequantizeScalar<int8_t>;
+    case kUint8: return dequantizeScalar<uint8_t>;
+    case kInt16: return dequantizeScalar<int16_t>;
+    case kUint16: return dequantizeScalar<uint16_t>;
+    case kInt32: return dequantizeScalar<int32_t>;
+    case kUint32: return dequantizeScalar<uint32_t>;
+    default: return nullptr;
+  }
+}
+
+/**
+ * The vectorized conversions for one instruction set. Each kernel converts
+ * whole vectors and leaves the remaining few elements to the scalar loop.
+ */
+struct Kernels {
+  const char *name;
+  Kernel float32ToFloat64;
+  Kernel float64ToFloat32;
+  Kernel int32ToFloat32;
+  Kernel int32ToFloat64;
+  Kernel int32ToInt8;
+  Kernel int32ToInt16;
+  Kernel int32ToBool;
+  Kernel uint8ToBool;
+  Kernel int8ToInt32;
+  Kernel uint8ToInt32;
+  Kernel int16ToInt32;
+  Kernel float16ToFloat32;
+  Kernel float32ToFloat16;
+  QuantizeKernel quantizeUint8;
+  QuantizeKernel quantizeInt8;
+  DequantizeKernel dequantizeUint8;
+  DequantizeKernel dequantizeInt8;
+};
+
+const Kernels kScalarKernels = {
+  "scalar",
+  convertScalar<float, double>,
+  convertScalar<double, float>,
+  convertScalar<int32_t, float>,
+  convertScalar<int32_t, double>,
+  convertScalar<int32_t, int8_t>,
+  convertScalar<int32_t, int16_t>,
+  convertScalarToBool<int32_t>,
+  convertScalarToBool<uint8_t>,
+  convertScalar<int8_t, int32_t>,
+  convertScalar<uint8_t, int32_t>,
+  convertScalar<int16_t, int32_t>,
+  float16ToFloat32Scalar,
+  float32ToFloat16Scalar,
+  quantizeScalar<uint8_t>,
+  quantizeScalar<int8_t>,
+  dequantizeScalar<uint8_t>,
+  dequantizeScalar<int8_t>,
+};
+
+#ifdef TFJS_CONVERSION_X86
+
+// SSE2 is part of x86-64, so these need no runtime check.
+
+void float32ToFloat64Sse2(const void *src, void *dst, size_t count) {
+  const float *s = static_cast<const float*>(src);
+  double *d = static_cast<double*>(dst);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 x = _mm_loadu_ps(s + i);
+    _mm_storeu_pd(d + i, _mm_cvtps_pd(x));
+    _mm_storeu_pd(d + i + 2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+  }
+  convertScalar<float, double>(s + i, d + i, count - i);
+}
+
+void float64ToFloat32Sse2(const void *src, void *dst, size_t count) {
+  const double *s = static_cast<const double*>(src);
+  float *d = static_cast<float*>(dst);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(s + i));
+    __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(s + i + 2));
+    _mm_storeu_ps(d + i, _mm_movelh_ps(lo, hi));
+  }
+  convertScalar<double, float>(s + i, d + i, count - i);
+}
+
+void int32ToFloat32Sse2(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  float *d = static_cast<float*>(dst);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    _mm_storeu_ps(d + i, _mm_cvtepi32_ps(x));
+  }
+  convertScalar<int32_t, float>(s + i, d + i, count - i);
+}
+
+void int32ToFloat64Sse2(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  double *d = static_cast<double*>(dst);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    _mm_storeu_pd(d + i, _mm_cvtepi32_pd(x));
+    _mm_storeu_pd(d + i + 2,
+                  _mm_cvtepi32_pd(_mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2))));
+  }
+  convertScalar<int32_t, double>(s + i, d + i, count - i);
+}
+
+/**
+ * Pack four vectors of int32 values in [0, 255] into one vector of bytes.
+ */
+inline __m128i packBytesSse2(__m128i a, __m128i b, __m128i c, __m128i e) {
+  return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, e));
+}
+
+void int32ToInt8Sse2(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  int8_t *d = static_cast<int8_t*>(dst);
+  const __m128i *v = reinterpret_cast<const __m128i*>(s);
+  const __m128i lowByte = _mm_set1_epi32(0xFF);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16, v += 4) {
+    __m128i a = _mm_and_si128(_mm_loadu_si128(v), lowByte);
+    __m128i b = _mm_and_si128(_mm_loadu_si128(v + 1), lowByte);
+    __m128i c = _mm_and_si128(_mm_loadu_si128(v + 2), lowByte);
+    __m128i e = _mm_and_si128(_mm_loadu_si128(v + 3), lowByte);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i),
+                     packBytesSse2(a, b, c, e));
+  }
+  convertScalar<int32_t, int8_t>(s + i, d + i, count - i);
+}
+
+void int32ToInt16Sse2(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  int16_t *d = static_cast<int16_t*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 4));
+    // Sign extend the low 16 bits so that packing does not saturate.
+    a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+    b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i),
+                     _mm_packs_epi32(a, b));
+  }
+  convertScalar<int32_t, int16_t>(s + i, d + i, count - i);
+}
+
+void int32ToBoolSse2(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  uint8_t *d = static_cast<uint8_t*>(dst);
+  const __m128i *v = reinterpret_cast<const __m128i*>(s);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi32(1);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16, v += 4) {
+    __m128i a = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_loadu_si128(v), zero),
+                                 one);
+    __m128i b = _mm_andnot_si128(
+        _mm_cmpeq_epi32(_mm_loadu_si128(v + 1), zero), one);
+    __m128i c = _mm_andnot_si128(
+        _mm_cmpeq_epi32(_mm_loadu_si128(v + 2), zero), one);
+    __m128i e = _mm_andnot_si128(
+        _mm_cmpeq_epi32(_mm_loadu_si128(v + 3), zero), one);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i),
+                     packBytesSse2(a, b, c, e));
+  }
+  convertScalarToBool<int32_t>(s + i, d + i, count - i);
+}
+
+void uint8ToBoolSse2(const void *src, void *dst, size_t count) {
+  const uint8_t *s = static_cast<const uint8_t*>(src);
+  uint8_t *d = static_cast<uint8_t*>(dst);
+  const __m128i one = _mm_set1_epi8(1);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), _mm_min_epu8(x, one));
+  }
+  convertScalarToBool<uint8_t>(s + i, d + i, count - i);
+}
+
+/**
+ * Widen eight int16 values, with their sign (or zero) extension in 'high', to
+ * int32 and store them at 'd'.
+ */
+inline void storeWidenedSse2(int32_t *d, __m128i x, __m128i high) {
+  __m128i *out = reinterpret_cast<__m128i*>(d);
+  _mm_storeu_si128(out, _mm_unpacklo_epi16(x, high));
+  _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(x, high));
+}
+
+void int8ToInt32Sse2(const void *src, void *dst, size_t count) {
+  const int8_t *s = static_cast<const int8_t*>(src);
+  int32_t *d = static_cast<int32_t*>(dst);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    __m128i sign = _mm_cmpgt_epi8(zero, x);
+    __m128i lo = _mm_unpacklo_epi8(x, sign);
+    __m128i hi = _mm_unpackhi_epi8(x, sign);
+    storeWidenedSse2(d + i, lo, _mm_srai_epi16(lo, 15));
+    storeWidenedSse2(d + i + 8, hi, _mm_srai_epi16(hi, 15));
+  }
+  convertScalar<int8_t, int32_t>(s + i, d + i, count - i);
+}
+
+void uint8ToInt32Sse2(const void *src, void *dst, size_t count) {
+  const uint8_t *s = static_cast<const uint8_t*>(src);
+  int32_t *d = static_cast<int32_t*>(dst);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    storeWidenedSse2(d + i, _mm_unpacklo_epi8(x, zero), zero);
+    storeWidenedSse2(d + i + 8, _mm_unpackhi_epi8(x, zero), zero);
+  }
+  convertScalar<uint8_t, int32_t>(s + i, d + i, count - i);
+}
+
+void int16ToInt32Sse2(const void *src, void *dst, size_t count) {
+  const int16_t *s = static_cast<const int16_t*>(src);
+  int32_t *d = static_cast<int32_t*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    storeWidenedSse2(d + i, x, _mm_srai_epi16(x, 15));
+  }
+  convertScalar<int16_t, int32_t>(s + i, d + i, count - i);
+}
+
+/**
+ * Quantize four floats to int32, clamped to [lo, hi] before the zero point is
+ * added. Rounds half away from zero by correcting the truncated value.
+ */
+inline __m128i quantizeSse2(__m128 x, __m128 scale, __m128 lo, __m128 hi,
+                            __m128i zeroPoint) {
+  // MAXPS returns its second operand for NaN, so NaN becomes 'lo'.
+  __m128 v = _mm_min_ps(_mm_max_ps(_mm_div_ps(x, scale), lo), hi);
+  __m128i truncated = _mm_cvttps_epi32(v);
+  __m128 fraction = _mm_sub_ps(v, _mm_cvtepi32_ps(truncated));
+  // All ones (-1) where the value needs rounding up or down.
+  __m128i up = _mm_castps_si128(_mm_cmpge_ps(fraction, _mm_set1_ps(0.5f)));
+  __m128i down =
+      _mm_castps_si128(_mm_cmple_ps(fraction, _mm_set1_ps(-0.5f)));
+  __m128i rounded = _mm_add_epi32(_mm_sub_epi32(truncated, up), down);
+  return _mm_add_epi32(rounded, zeroPoint);
+}
+
+template <typename Q>
+void quantizeBytesSse2(const float *src, void *dst, float scale,
+                       int32_t zeroPoint, size_t count) {
+  Q *d = static_cast<Q*>(dst);
+  const __m128 vscale = _mm_set1_ps(scale);
+  const __m128 lo = _mm_set1_ps(
+      static_cast<float>(std::numeric_limits<Q>::min() - zeroPoint));
+  const __m128 hi = _mm_set1_ps(
+      static_cast<float>(std::numeric_limits<Q>::max() - zeroPoint));
+  const __m128i zp = _mm_set1_epi32(zeroPoint);
+  const bool isSigned = std::numeric_limits<Q>::is_signed;
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i a = quantizeSse2(_mm_loadu_ps(src + i), vscale, lo, hi, zp);
+    __m128i b = quantizeSse2(_mm_loadu_ps(src + i + 4), vscale, lo, hi, zp);
+    __m128i c = quantizeSse2(_mm_loadu_ps(src + i + 8), vscale, lo, hi, zp);
+    __m128i e = quantizeSse2(_mm_loadu_ps(src + i + 12), vscale, lo, hi, zp);
+    // The values are already in range, so the saturating packs are exact.
+    __m128i ab = _mm_packs_epi32(a, b);
+    __m128i ce = _mm_packs_epi32(c, e);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i),
+                     isSigned ? _mm_packs_epi16(ab, ce)
+                              : _mm_packus_epi16(ab, ce));
+  }
+  quantizeScalar<Q>(src + i, d + i, scale, zeroPoint, count - i);
+}
+
+/**
+ * Widen 16 bytes to four vectors of int32.
+ */
+inline void widenBytesSse2(__m128i x, bool isSigned, __m128i out[4]) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sign = isSigned ? _mm_cmpgt_epi8(zero, x) : zero;
+  __m128i lo = _mm_unpacklo_epi8(x, sign);
+  __m128i hi = _mm_unpackhi_epi8(x, sign);
+  __m128i loSign = isSigned ? _mm_srai_epi16(lo, 15) : zero;
+  __m128i hiSign = isSigned ? _mm_srai_epi16(hi, 15) : zero;
+  out[0] = _mm_unpacklo_epi16(lo, loSign);
+  out[1] = _mm_unpackhi_epi16(lo, loSign);
+  out[2] = _mm_unpacklo_epi16(hi, hiSign);
+  out[3] = _mm_unpackhi_epi16(hi, hiSign);
+}
+
+template <typename Q>
+void dequantizeBytesSse2(const void *src, float *dst, float scale,
+                         int32_t zeroPoint, size_t count) {
+  const Q *s = static_cast<const Q*>(src);
+  const __m128 vscale = _mm_set1_ps(scale);
+  const __m128i zp = _mm_set1_epi32(zeroPoint);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i widened[4];
+    widenBytesSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i)),
+                   std::numeric_limits<Q>::is_signed, widened);
+    for (int j = 0; j < 4; j++) {
+      __m128 v = _mm_cvtepi32_ps(_mm_sub_epi32(widened[j], zp));
+      _mm_storeu_ps(dst + i + 4 * j, _mm_mul_ps(v, vscale));
+    }
+  }
+  dequantizeScalar<Q>(s + i, dst + i, scale, zeroPoint, count - i);
+}
+
+const Kernels kSse2Kernels = {
+  "sse2",
+  float32ToFloat64Sse2,
+  float64ToFloat32Sse2,
+  int32ToFloat32Sse2,
+  int32ToFloat64Sse2,
+  int32ToInt8Sse2,
+  int32ToInt16Sse2,
+  int32ToBoolSse2,
+  uint8ToBoolSse2,
+  int8ToInt32Sse2,
+  uint8ToInt32Sse2,
+  int16ToInt32Sse2,
+  float16ToFloat32Scalar,
+  float32ToFloat16Scalar,
+  quantizeBytesSse2<uint8_t>,
+  quantizeBytesSse2<int8_t>,
+  dequantizeBytesSse2<uint8_t>,
+  dequantizeBytesSse2<int8_t>,
+};
+
+TFJS_TARGET_AVX2
+void float32ToFloat64Avx2(const void *src, void *dst, size_t count) {
+  const float *s = static_cast<const float*>(src);
+  double *d = static_cast<double*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_pd(d + i, _mm256_cvtps_pd(_mm_loadu_ps(s + i)));
+    _mm256_storeu_pd(d + i + 4, _mm256_cvtps_pd(_mm_loadu_ps(s + i + 4)));
+  }
+  convertScalar<float, double>(s + i, d + i, count - i);
+}
+
+TFJS_TARGET_AVX2
+void float64ToFloat32Avx2(const void *src, void *dst, size_t count) {
+  const double *s = static_cast<const double*>(src);
+  float *d = static_cast<float*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm_storeu_ps(d + i, _mm256_cvtpd_ps(_mm256_loadu_pd(s + i)));
+    _mm_storeu_ps(d + i + 4, _mm256_cvtpd_ps(_mm256_loadu_pd(s + i + 4)));
+  }
+  convertScalar<double, float>(s + i, d + i, count - i);
+}
+
+TFJS_TARGET_AVX2
+void int32ToFloat32Avx2(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  float *d = static_cast<float*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    _mm256_storeu_ps(d + i, _mm256_cvtepi32_ps(x));
+  }
+  convertScalar<int32_t, float>(s + i, d + i, count - i);
+}
+
+TFJS_TARGET_AVX2
+void int32ToFloat64Avx2(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  double *d = static_cast<double*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 4));
+    _mm256_storeu_pd(d + i, _mm256_cvtepi32_pd(lo));
+    _mm256_storeu_pd(d + i + 4, _mm256_cvtepi32_pd(hi));
+  }
+  convertScalar<int32_t, double>(s + i, d + i, count - i);
+}
+
+/**
+ * Pack four vectors of int32 values in [0, 255] into one vector of bytes.
+ * Packing works within 128 bit lanes, so the 32 bit groups are put back in
+ * order afterwards.
+ */
+TFJS_TARGET_AVX2
+inline __m256i packBytesAvx2(__m256i a, __m256i b, __m256i c, __m256i e) {
+  __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, b),
+                                       _mm256_packs_epi32(c, e));
+  return _mm256_permutevar8x32_epi32(
+      packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+TFJS_TARGET_AVX2
+void int32ToInt8Avx2(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  int8_t *d = static_cast<int8_t*>(dst);
+  const __m256i *v = reinterpret_cast<const __m256i*>(s);
+  const __m256i lowByte = _mm256_set1_epi32(0xFF);
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32, v += 4) {
+    __m256i a = _mm256_and_si256(_mm256_loadu_si256(v), lowByte);
+    __m256i b = _mm256_and_si256(_mm256_loadu_si256(v + 1), lowByte);
+    __m256i c = _mm256_and_si256(_mm256_loadu_si256(v + 2), lowByte);
+    __m256i e = _mm256_and_si256(_mm256_loadu_si256(v + 3), lowByte);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i),
+                        packBytesAvx2(a, b, c, e));
+  }
+  convertScalar<int32_t, int8_t>(s + i, d + i, count - i);
+}
+
+TFJS_TARGET_AVX2
+void int32ToInt16Avx2(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  int16_t *d = static_cast<int16_t*>(dst);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + 8));
+    a = _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16);
+    b = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16);
+    // Undo the lane interleaving of the pack.
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i), packed);
+  }
+  convertScalar<int32_t, int16_t>(s + i, d + i, count - i);
+}
+
+TFJS_TARGET_AVX2
+void int32ToBoolAvx2(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  uint8_t *d = static_cast<uint8_t*>(dst);
+  const __m256i *v = reinterpret_cast<const __m256i*>(s);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32, v += 4) {
+    __m256i a = _mm256_andnot_si256(
+        _mm256_cmpeq_epi32(_mm256_loadu_si256(v), zero), one);
+    __m256i b = _mm256_andnot_si256(
+        _mm256_cmpeq_epi32(_mm256_loadu_si256(v + 1), zero), one);
+    __m256i c = _mm256_andnot_si256(
+        _mm256_cmpeq_epi32(_mm256_loadu_si256(v + 2), zero), one);
+    __m256i e = _mm256_andnot_si256(
+        _mm256_cmpeq_epi32(_mm256_loadu_si256(v + 3), zero), one);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i),
+                        packBytesAvx2(a, b, c, e));
+  }
+  convertScalarToBool<int32_t>(s + i, d + i, count - i);
+}
+
+TFJS_TARGET_AVX2
+void uint8ToBoolAvx2(const void *src, void *dst, size_t count) {
+  const uint8_t *s = static_cast<const uint8_t*>(src);
+  uint8_t *d = static_cast<uint8_t*>(dst);
+  const __m256i one = _mm256_set1_epi8(1);
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i),
+                        _mm256_min_epu8(x, one));
+  }
+  convertScalarToBool<uint8_t>(s + i, d + i, count - i);
+}
+
+TFJS_TARGET_AVX2
+void int8ToInt32Avx2(const void *src, void *dst, size_t count) {
+  const int8_t *s = static_cast<const int8_t*>(src);
+  int32_t *d = static_cast<int32_t*>(dst);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    __m256i *out = reinterpret_cast<__m256i*>(d + i);
+    _mm256_storeu_si256(out, _mm256_cvtepi8_epi32(x));
+    _mm256_storeu_si256(out + 1, _mm256_cvtepi8_epi32(_mm_srli_si128(x, 8)));
+  }
+  convertScalar<int8_t, int32_t>(s + i, d + i, count - i);
+}
+
+TFJS_TARGET_AVX2
+void uint8ToInt32Avx2(const void *src, void *dst, size_t count) {
+  const uint8_t *s = static_cast<const uint8_t*>(src);
+  int32_t *d = static_cast<int32_t*>(dst);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    __m256i *out = reinterpret_cast<__m256i*>(d + i);
+    _mm256_storeu_si256(out, _mm256_cvtepu8_epi32(x));
+    _mm256_storeu_si256(out + 1, _mm256_cvtepu8_epi32(_mm_srli_si128(x, 8)));
+  }
+  convertScalar<uint8_t, int32_t>(s + i, d + i, count - i);
+}
+
+TFJS_TARGET_AVX2
+void int16ToInt32Avx2(const void *src, void *dst, size_t count) {
+  const int16_t *s = static_cast<const int16_t*>(src);
+  int32_t *d = static_cast<int32_t*>(dst);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m128i *in = reinterpret_cast<const __m128i*>(s + i);
+    __m256i *out = reinterpret_cast<__m256i*>(d + i);
+    _mm256_storeu_si256(out, _mm256_cvtepi16_epi32(_mm_loadu_si128(in)));
+    _mm256_storeu_si256(out + 1,
+                        _mm256_cvtepi16_epi32(_mm_loadu_si128(in + 1)));
+  }
+  convertScalar<int16_t, int32_t>(s + i, d + i, count - i);
+}
+
+TFJS_TARGET_AVX2
+inline __m256i quantizeAvx2(__m256 x, __m256 scale, __m256 lo, __m256 hi,
+                            __m256i zeroPoint) {
+  __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(x, scale), lo), hi);
+  __m256i truncated = _mm256_cvttps_epi32(v);
+  __m256 fraction = _mm256_sub_ps(v, _mm256_cvtepi32_ps(truncated));
+  __m256i up = _mm256_castps_si256(
+      _mm256_cmp_ps(fraction, _mm256_set1_ps(0.5f), _CMP_GE_OQ));
+  __m256i down = _mm256_castps_si256(
+      _mm256_cmp_ps(fraction, _mm256_set1_ps(-0.5f), _CMP_LE_OQ));
+  __m256i rounded = _mm256_add_epi32(_mm256_sub_epi32(truncated, up), down);
+  return _mm256_add_epi32(rounded, zeroPoint);
+}
+
+template <typename Q>
+TFJS_TARGET_AVX2
+void quantizeBytesAvx2(const float *src, void *dst, float scale,
+                       int32_t zeroPoint, size_t count) {
+  Q *d = static_cast<Q*>(dst);
+  const __m256 vscale = _mm256_set1_ps(scale);
+  const __m256 lo = _mm256_set1_ps(
+      static_cast<float>(std::numeric_limits<Q>::min() - zeroPoint));
+  const __m256 hi = _mm256_set1_ps(
+      static_cast<float>(std::numeric_limits<Q>::max() - zeroPoint));
+  const __m256i zp = _mm256_set1_epi32(zeroPoint);
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  const bool isSigned = std::numeric_limits<Q>::is_signed;
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32) {
+    __m256i a = quantizeAvx2(_mm256_loadu_ps(src + i), vscale, lo, hi, zp);
+    __m256i b =
+        quantizeAvx2(_mm256_loadu_ps(src + i + 8), vscale, lo, hi, zp);
+    __m256i c =
+        quantizeAvx2(_mm256_loadu_ps(src + i + 16), vscale, lo, hi, zp);
+    __m256i e =
+        quantizeAvx2(_mm256_loadu_ps(src + i + 24), vscale, lo, hi, zp);
+    __m256i ab = _mm256_packs_epi32(a, b);
+    __m256i ce = _mm256_packs_epi32(c, e);
+    __m256i packed = isSigned ? _mm256_packs_epi16(ab, ce)
+                              : _mm256_packus_epi16(ab, ce);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i),
+                        _mm256_permutevar8x32_epi32(packed, order));
+  }
+  quantizeScalar<Q>(src + i, d + i, scale, zeroPoint, count - i);
+}
+
+template <typename Q>
+TFJS_TARGET_AVX2
+void dequantizeBytesAvx2(const void *src, float *dst, float scale,
+                         int32_t zeroPoint, size_t count) {
+  const Q *s = static_cast<const Q*>(src);
+  const __m256 vscale = _mm256_set1_ps(scale);
+  const __m256i zp = _mm256_set1_epi32(zeroPoint);
+  const bool isSigned = std::numeric_limits<Q>::is_signed;
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    __m128i high = _mm_srli_si128(x, 8);
+    __m256i a = isSigned ? _mm256_cvtepi8_epi32(x) : _mm256_cvtepu8_epi32(x);
+    __m256i b = isSigned ? _mm256_cvtepi8_epi32(high)
+                         : _mm256_cvtepu8_epi32(high);
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(
+        _mm256_cvtepi32_ps(_mm256_sub_epi32(a, zp)), vscale));
+    _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(
+        _mm256_cvtepi32_ps(_mm256_sub_epi32(b, zp)), vscale));
+  }
+  dequantizeScalar<Q>(s + i, dst + i, scale, zeroPoint, count - i);
+}
+
+const Kernels kAvx2Kernels = {
+  "avx2",
+  float32ToFloat64Avx2,
+  float64ToFloat32Avx2,
+  int32ToFloat32Avx2,
+  int32ToFloat64Avx2,
+  int32ToInt8Avx2,
+  int32ToInt16Avx2,
+  int32ToBoolAvx2,
+  uint8ToBoolAvx2,
+  int8ToInt32Avx2,
+  uint8ToInt32Avx2,
+  int16ToInt32Avx2,
+  float16ToFloat32Scalar,
+  float32ToFloat16Scalar,
+  quantizeBytesAvx2<uint8_t>,
+  quantizeBytesAvx2<int8_t>,
+  dequantizeBytesAvx2<uint8_t>,
+  dequantizeBytesAvx2<int8_t>,
+};
+
+bool cpuSupportsAvx2() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  // The OS must also save the AVX registers on context switches.
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// F16C is not implied by AVX2, so it has its own kernels and check.
+
+TFJS_TARGET_F16C
+void float16ToFloat32F16c(const void *src, void *dst, size_t count) {
+  const uint16_t *s = static_cast<const uint16_t*>(src);
+  float *d = static_cast<float*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    _mm256_storeu_ps(d + i, _mm256_cvtph_ps(x));
+  }
+  float16ToFloat32Scalar(s + i, d + i, count - i);
+}
+
+TFJS_TARGET_F16C
+void float32ToFloat16F16c(const void *src, void *dst, size_t count) {
+  const float *s = static_cast<const float*>(src);
+  uint16_t *d = static_cast<uint16_t*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i x = _mm256_cvtps_ph(_mm256_loadu_ps(s + i),
+                                _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), x);
+  }
+  float32ToFloat16Scalar(s + i, d + i, count - i);
+}
+
+bool cpuSupportsF16c() {
+  // CPUID leaf 1, ECX: OSXSAVE (27), AVX (28) and F16C (29).
+  const int kRequired = (1 << 27) | (1 << 28) | (1 << 29);
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  if ((info[2] & kRequired) != kRequired) {
+    return false;
+  }
+  return (_xgetbv(0) & 6) == 6;
+#else
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)
+      || (ecx & kRequired) != kRequired) {
+    return false;
+  }
+  // The OS must save the AVX registers, which XGETBV reports.
+  unsigned int xcr0;
+  __asm__("xgetbv" : "=a"(xcr0) : "c"(0) : "%edx");
+  return (xcr0 & 6) == 6;
+#endif
+}
+
+#endif  // TFJS_CONVERSION_X86
+
+#ifdef TFJS_CONVERSION_NEON
+
+// NEON is part of arm64, so these need no runtime check.
+
+void float32ToFloat64Neon(const void *src, void *dst, size_t count) {
+  const float *s = static_cast<const float*>(src);
+  double *d = static_cast<double*>(dst);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t x = vld1q_f32(s + i);
+    vst1q_f64(d + i, vcvt_f64_f32(vget_low_f32(x)));
+    vst1q_f64(d + i + 2, vcvt_high_f64_f32(x));
+  }
+  convertScalar<float, double>(s + i, d + i, count - i);
+}
+
+void float64ToFloat32Neon(const void *src, void *dst, size_t count) {
+  const double *s = static_cast<const double*>(src);
+  float *d = static_cast<float*>(dst);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    float32x2_t lo = vcvt_f32_f64(vld1q_f64(s + i));
+    vst1q_f32(d + i, vcvt_high_f32_f64(lo, vld1q_f64(s + i + 2)));
+  }
+  convertScalar<double, float>(s + i, d + i, count - i);
+}
+
+void int32ToFloat32Neon(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  float *d = static_cast<float*>(dst);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1q_f32(d + i, vcvtq_f32_s32(vld1q_s32(s + i)));
+  }
+  convertScalar<int32_t, float>(s + i, d + i, count - i);
+}
+
+void int32ToFloat64Neon(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  double *d = static_cast<double*>(dst);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    int32x4_t x = vld1q_s32(s + i);
+    vst1q_f64(d + i, vcvtq_f64_s64(vmovl_s32(vget_low_s32(x))));
+    vst1q_f64(d + i + 2, vcvtq_f64_s64(vmovl_high_s32(x)));
+  }
+  convertScalar<int32_t, double>(s + i, d + i, count - i);
+}
+
+void float16ToFloat32Neon(const void *src, void *dst, size_t count) {
+  const uint16_t *s = static_cast<const uint16_t*>(src);
+  float *d = static_cast<float*>(dst);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1q_f32(d + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(s + i))));
+  }
+  float16ToFloat32Scalar(s + i, d + i, count - i);
+}
+
+void float32ToFloat16Neon(const void *src, void *dst, size_t count) {
+  const float *s = static_cast<const float*>(src);
+  uint16_t *d = static_cast<uint16_t*>(dst);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    vst1_u16(d + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(s + i))));
+  }
+  float32ToFloat16Scalar(s + i, d + i, count - i);
+}
+
+// Narrowing moves keep the low bits, which is the truncation we want.
+
+void int32ToInt8Neon(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  int8_t *d = static_cast<int8_t*>(dst);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    int16x8_t ab = vcombine_s16(vmovn_s32(vld1q_s32(s + i)),
+                                vmovn_s32(vld1q_s32(s + i + 4)));
+    int16x8_t ce = vcombine_s16(vmovn_s32(vld1q_s32(s + i + 8)),
+                                vmovn_s32(vld1q_s32(s + i + 12)));
+    vst1q_s8(d + i, vcombine_s8(vmovn_s16(ab), vmovn_s16(ce)));
+  }
+  convertScalar<int32_t, int8_t>(s + i, d + i, count - i);
+}
+
+void int32ToInt16Neon(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  int16_t *d = static_cast<int16_t*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    vst1q_s16(d + i, vcombine_s16(vmovn_s32(vld1q_s32(s + i)),
+                                  vmovn_s32(vld1q_s32(s + i + 4))));
+  }
+  convertScalar<int32_t, int16_t>(s + i, d + i, count - i);
+}
+
+void int32ToBoolNeon(const void *src, void *dst, size_t count) {
+  const int32_t *s = static_cast<const int32_t*>(src);
+  uint8_t *d = static_cast<uint8_t*>(dst);
+  const uint32x4_t one = vdupq_n_u32(1);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    uint32x4_t x[4];
+    for (int j = 0; j < 4; j++) {
+      int32x4_t v = vld1q_s32(s + i + 4 * j);
+      x[j] = vandq_u32(vtstq_s32(v, v), one);
+    }
+    uint16x8_t ab = vcombine_u16(vmovn_u32(x[0]), vmovn_u32(x[1]));
+    uint16x8_t ce = vcombine_u16(vmovn_u32(x[2]), vmovn_u32(x[3]));
+    vst1q_u8(d + i, vcombine_u8(vmovn_u16(ab), vmovn_u16(ce)));
+  }
+  convertScalarToBool<int32_t>(s + i, d + i, count - i);
+}
+
+void uint8ToBoolNeon(const void *src, void *dst, size_t count) {
+  const uint8_t *s = static_cast<const uint8_t*>(src);
+  uint8_t *d = static_cast<uint8_t*>(dst);
+  const uint8x16_t one = vdupq_n_u8(1);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    vst1q_u8(d + i, vminq_u8(vld1q_u8(s + i), one));
+  }
+  convertScalarToBool<uint8_t>(s + i, d + i, count - i);
+}
+
+void int8ToInt32Neon(const void *src, void *dst, size_t count) {
+  const int8_t *s = static_cast<const int8_t*>(src);
+  int32_t *d = static_cast<int32_t*>(dst);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    int8x16_t x = vld1q_s8(s + i);
+    int16x8_t lo = vmovl_s8(vget_low_s8(x));
+    int16x8_t hi = vmovl_high_s8(x);
+    vst1q_s32(d + i, vmovl_s16(vget_low_s16(lo)));
+    vst1q_s32(d + i + 4, vmovl_high_s16(lo));
+    vst1q_s32(d + i + 8, vmovl_s16(vget_low_s16(hi)));
+    vst1q_s32(d + i + 12, vmovl_high_s16(hi));
+  }
+  convertScalar<int8_t, int32_t>(s + i, d + i, count - i);
+}
+
+void uint8ToInt32Neon(const void *src, void *dst, size_t count) {
+  const uint8_t *s = static_cast<const uint8_t*>(src);
+  int32_t *d = static_cast<int32_t*>(dst);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t x = vld1q_u8(s + i);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(x));
+    uint16x8_t hi = vmovl_high_u8(x);
+    vst1q_s32(d + i, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(lo))));
+    vst1q_s32(d + i + 4, vreinterpretq_s32_u32(vmovl_high_u16(lo)));
+    vst1q_s32(d + i + 8, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(hi))));
+    vst1q_s32(d + i + 12, vreinterpretq_s32_u32(vmovl_high_u16(hi)));
+  }
+  convertScalar<uint8_t, int32_t>(s + i, d + i, count - i);
+}
+
+void int16ToInt32Neon(const void *src, void *dst, size_t count) {
+  const int16_t *s = static_cast<const int16_t*>(src);
+  int32_t *d = static_cast<int32_t*>(dst);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    int16x8_t x = vld1q_s16(s + i);
+    vst1q_s32(d + i, vmovl_s16(vget_low_s16(x)));
+    vst1q_s32(d + i + 4, vmovl_high_s16(x));
+  }
+  convertScalar<int16_t, int32_t>(s + i, d + i, count - i);
+}
+
+/**
+ * Quantize four floats to int32. NaN fails both comparisons and becomes
+ * 'lo', and vcvta rounds half away from zero like std::round.
+ */
+inline int32x4_t quantizeNeon(float32x4_t x, float32x4_t scale,
+                              float32x4_t lo, float32x4_t hi,
+                              int32x4_t zeroPoint) {
+  float32x4_t v = vdivq_f32(x, scale);
+  v = vbslq_f32(vcgtq_f32(v, lo), v, lo);
+  v = vbslq_f32(vcltq_f32(v, hi), v, hi);
+  return vaddq_s32(vcvtaq_s32_f32(v), zeroPoint);
+}
+
+void quantizeUint8Neon(const float *src, void *dst, float scale,
+                       int32_t zeroPoint, size_t count) {
+  uint8_t *d = static_cast<uint8_t*>(dst);
+  const float32x4_t vscale = vdupq_n_f32(scale);
+  const float32x4_t lo = vdupq_n_f32(static_cast<float>(0 - zeroPoint));
+  const float32x4_t hi = vdupq_n_f32(static_cast<float>(255 - zeroPoint));
+  const int32x4_t zp = vdupq_n_s32(zeroPoint);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    int32x4_t q[4];
+    for (int j = 0; j < 4; j++) {
+      q[j] = quantizeNeon(vld1q_f32(src + i + 4 * j), vscale, lo, hi, zp);
+    }
+    int16x8_t ab = vcombine_s16(vqmovn_s32(q[0]), vqmovn_s32(q[1]));
+    int16x8_t ce = vcombine_s16(vqmovn_s32(q[2]), vqmovn_s32(q[3]));
+    vst1q_u8(d + i, vcombine_u8(vqmovun_s16(ab), vqmovun_s16(ce)));
+  }
+  quantizeScalar<uint8_t>(src + i, d + i, scale, zeroPoint, count - i);
+}
+
+void quantizeInt8Neon(const float *src, void *dst, float scale,
+                      int32_t zeroPoint, size_t count) {
+  int8_t *d = static_cast<int8_t*>(dst);
+  const float32x4_t vscale = vdupq_n_f32(scale);
+  const float32x4_t lo = vdupq_n_f32(static_cast<float>(-128 - zeroPoint));
+  const float32x4_t hi = vdupq_n_f32(static_cast<float>(127 - zeroPoint));
+  const int32x4_t zp = vdupq_n_s32(zeroPoint);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    int32x4_t q[4];
+    for (int j = 0; j < 4; j++) {
+      q[j] = quantizeNeon(vld1q_f32(src + i + 4 * j), vscale, lo, hi, zp);
+    }
+    int16x8_t ab = vcombine_s16(vqmovn_s32(q[0]), vqmovn_s32(q[1]));
+    int16x8_t ce = vcombine_s16(vqmovn_s32(q[2]), vqmovn_s32(q[3]));
+    vst1q_s8(d + i, vcombine_s8(vqmovn_s16(ab), vqmovn_s16(ce)));
+  }
+  quantizeScalar<int8_t>(src + i, d + i, scale, zeroPoint, count - i);
+}
+
+inline void storeDequantizedNeon(float *d, int16x8_t x, int32x4_t zp,
+                                 float32x4_t scale) {
+  int32x4_t lo = vsubq_s32(vmovl_s16(vget_low_s16(x)), zp);
+  int32x4_t hi = vsubq_s32(vmovl_high_s16(x), zp);
+  vst1q_f32(d, vmulq_f32(vcvtq_f32_s32(lo), scale));
+  vst1q_f32(d + 4, vmulq_f32(vcvtq_f32_s32(hi), scale));
+}
+
+void dequantizeUint8Neon(const void *src, float *dst, float scale,
+                         int32_t zeroPoint, size_t count) {
+  const uint8_t *s = static_cast<const uint8_t*>(src);
+  const float32x4_t vscale = vdupq_n_f32(scale);
+  const int32x4_t zp = vdupq_n_s32(zeroPoint);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t x = vld1q_u8(s + i);
+    // Widened bytes fit in int16 whether or not they are signed.
+    storeDequantizedNeon(dst + i,
+                         vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(x))), zp,
+                         vscale);
+    storeDequantizedNeon(dst + i + 8,
+                         vreinterpretq_s16_u16(vmovl_high_u8(x)), zp, vscale);
+  }
+  dequantizeScalar<uint8_t>(s + i, dst + i, scale, zeroPoint, count - i);
+}
+
+void dequantizeInt8Neon(const void *src, float *dst, float scale,
+                        int32_t zeroPoint, size_t count) {
+  const int8_t *s = static_cast<const int8_t*>(src);
+  const float32x4_t vscale = vdupq_n_f32(scale);
+  const int32x4_t zp = vdupq_n_s32(zeroPoint);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    int8x16_t x = vld1q_s8(s + i);
+    storeDequantizedNeon(dst + i, vmovl_s8(vget_low_s8(x)), zp, vscale);
+    storeDequantizedNeon(dst + i + 8, vmovl_high_s8(x), zp, vscale);
+  }
+  dequantizeScalar<int8_t>(s + i, dst + i, scale, zeroPoint, count - i);
+}
+
+const Kernels kNeonKernels = {
+  "neon",
+  float32ToFloat64Neon,
+  float64ToFloat32Neon,
+  int32ToFloat32Neon,
+  int32ToFloat64Neon,
+  int32ToInt8Neon,
+  int32ToInt16Neon,
+  int32ToBoolNeon,
+  uint8ToBoolNeon,
+  int8ToInt32Neon,
+  uint8ToInt32Neon,
+  int16ToInt32Neon,
+  float16ToFloat32Neon,
+  float32ToFloat16Neon,
+  quantizeUint8Neon,
+  quantizeInt8Neon,
+  dequantizeUint8Neon,
+  dequantizeInt8Neon,
+};
+
+#endif  // TFJS_CONVERSION_NEON
+
+Kernels selectKernels() {
+#if defined(TFJS_CONVERSION_X86)
+  Kernels selected = cpuSupportsAvx2() ? kAvx2Kernels : kSse2Kernels;
+  if (cpuSupportsF16c()) {
+    selected.float16ToFloat32 = float16ToFloat32F16c;
+    selected.float32ToFloat16 = float32ToFloat16F16c;
+  }
+  return selected;
+#elif defined(TFJS_CONVERSION_NEON)
+  return kNeonKernels;
+#else
+  return kScalarKernels;
+#endif
+}
+
+const Kernels &kernels() {
+  // Thread safe since C++11.
+  static const Kernels selected = selectKernels();
+  return selected;
+}
+
+/**
+ * Convert to or from float16 through float32, a block at a time.
+ */
+void convertThroughFloat32(const void *src, ElementType from, void *dst,
+                           ElementType to, size_t count) {
+  const size_t kBlockSize = 1024;
+  float block[kBlockSize];
+  const uint8_t *s = static_cast<const uint8_t*>(src);
+  uint8_t *d = static_cast<uint8_t*>(dst);
+  size_t fromSize = elementSize(from);
+  size_t toSize = elementSize(to);
+  for (size_t i = 0; i < count; i += kBlockSize) {
+    size_t n = count - i < kBlockSize ? count - i : kBlockSize;
+    convertElements(s + i * fromSize, from, block, kFloat32, n);
+    convertElements(block, kFloat32, d + i * toSize, to, n);
+  }
+}
+
+/**
+ * Whether converting between the two types copies the bytes unchanged.
+ */
+bool isBitwiseCopy(ElementType from, ElementType to) {
+  if (from == to) {
+    return true;
+  }
+  if (elementSize(from) != elementSize(to) || to == kBool) {
+    return false;
+  }
+  // Integers of the same size only differ in how the bits are read.
+  return from != kFloat16 && from != kFloat32 && from != kFloat64
+      && to != kFloat16 && to != kFloat32 && to != kFloat64;
+}
+
+/**
+ * The vectorized kernel for a conversion, if there is one. Signed and
+ * unsigned integers of the same size share kernels wherever the truncation
+ * or extension does not depend on the source's sign.
+ */
+Kernel vectorKernel(const Kernels &k, ElementType from, ElementType to) {
+  switch (from) {
+    case kFloat32:
+      return to == kFloat64 ? k.float32ToFloat64 : nullptr;
+    case kFloat64:
+      return to == kFloat32 ? k.float64ToFloat32 : nullptr;
+    case kInt32:
+    case kUint32:
+      switch (to) {
+        case kFloat32:
+          return from == kInt32 ? k.int32ToFloat32 : nullptr;
+        case kFloat64:
+          return from == kInt32 ? k.int32ToFloat64 : nullptr;
+        case kInt8:
+        case kUint8:
+          return k.int32ToInt8;
+        case kInt16:
+        case kUint16:
+          return k.int32ToInt16;
+        case kBool:
+          return k.int32ToBool;
+        default:
+          return nullptr;
+      }
+    case kInt8:
+      if (to == kBool) {
+        return k.uint8ToBool;
+      }
+      return to == kInt32 || to == kUint32 ? k.int8ToInt32 : nullptr;
+    case kUint8:
+    case kBool:
+      if (to == kBool) {
+        return k.uint8ToBool;
+      }
+      return to == kInt32 || to == kUint32 ? k.uint8ToInt32 : nullptr;
+    case kInt16:
+      return to == kInt32 || to == kUint32 ? k.int16ToInt32 : nullptr;
+    default:
+      return nullptr;
+  }
+}
+
+}  // namespace
+
+size_t elementSize(ElementType type) {
+  switch (type) {
+    case kInt8:
+    case kUint8:
+    case kBool:
+      return 1;
+    case kInt16:
+    case kUint16:
+    case kFloat16:
+      return 2;
+    case kInt32:
+    case kUint32:
+    case kFloat32:
+      return 4;
+    case kFloat64:
+      return 8;
+  }
+  return 0;
+}
+
+void convertElements(const void *src, ElementType from, void *dst,
+                     ElementType to, size_t count) {
+  if (count == 0) {
+    return;
+  }
+  if (isBitwiseCopy(from, to)) {
+    std::memcpy(dst, src, count * elementSize(from));
+    return;
+  }
+  if (from == kFloat16 && to == kFloat32) {
+    kernels().float16ToFloat32(src, dst, count);
+    return;
+  }
+  if (from == kFloat32 && to == kFloat16) {
+    kernels().float32ToFloat16(src, dst, count);
+    return;
+  }
+  if (from == kFloat16 || to == kFloat16) {
+    convertThroughFloat32(src, from, dst, to, count);
+    return;
+  }
+  Kernel kernel = vectorKernel(kernels(), from, to);
+  if (kernel == nullptr) {
+    kernel = scalarKernel(from, to);
+  }
+  kernel(src, dst, count);
+}
+
+bool quantizeFloat32(const float *src, void *dst, ElementType to, float scale,
+                     int32_t zeroPoint, size_t count) {
+  QuantizeKernel kernel;
+  switch (to) {
+    case kUint8:
+      kernel = kernels().quantizeUint8;
+      break;
+    case kInt8:
+      kernel = kernels().quantizeInt8;
+      break;
+    default:
+      kernel = scalarQuantizeKernel(to);
+      break;
+  }
+  if (kernel == nullptr) {
+    return false;
+  }
+  kernel(src, dst, scale, zeroPoint, count);
+  return true;
+}
+
+bool dequantizeToFloat32(const void *src, ElementType from, float *dst,
+                         float scale, int32_t zeroPoint, size_t count) {
+  DequantizeKernel kernel;
+  switch (from) {
+    case kUint8:
+      kernel = kernels().dequantizeUint8;
+      break;
+    case kInt8:
+      kernel = kernels().dequantizeInt8;
+      break;
+    default:
+      kernel = scalarDequantizeKernel(from);
+      break;
+  }
+  if (kernel == nullptr) {
+    return false;
+  }
+  kernel(src, dst, scale, zeroPoint, count);
+  return true;
+}
+
+const char *simdLevel() {
+  return kernels().name;
+}
+
+}  // namespace tensor_conversion
@@ -0,0 +1,88 @@
+/**
+ * @license
+ * Copyright 2022 Google LLC. All Rights Reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * =============================================================================
+ */
+
+#ifndef TFJS_TFLITE_NODE_TENSOR_CONVERSION_H_
+#define TFJS_TFLITE_NODE_TENSOR_CONVERSION_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tensor_conversion {
+
+/**
+ * Element types that can be converted between. These are the element types
+ * of the JS TypedArrays and of the TFLite tensors they are copied to and from.
+ */
+enum ElementType {
+  kInt8,
+  kUint8,
+  kInt16,
+  kUint16,
+  kInt32,
+  kUint32,
+  kFloat32,
+  kFloat64,
+  // One byte per element, always 0 or 1.
+  kBool,
+  // IEEE half precision, stored as uint16 bits.
+  kFloat16,
+};
+
+size_t elementSize(ElementType type);
+
+/**
+ * Convert 'count' elements of type 'from' at 'src' to type 'to' at 'dst'. The
+ * buffers must not overlap.
+ *
+ * Conversions follow the JS TypedArray rules, so the result matches what
+ * 'DstArray.from(srcArray)' would produce: integers are truncated to the
+ * low bits of the destination type, floats are truncated towards zero before
+ * that, and NaN or infinite values become 0. Converting to kBool maps every
+ * nonzero value to 1. Floats are rounded to nearest even when converted to
+ * kFloat16, and values too large for it become infinity.
+ *
+ * Common conversions use SSE2 or AVX2 on x86-64 and NEON on arm64, and
+ * float16 conversions use F16C where the CPU has it. The
+ * fastest one the CPU supports is picked the first time this is called.
+ */
+void convertElements(const void *src, ElementType from, void *dst,
+                     ElementType to, size_t count);
+
+/**
+ * Quantize 'count' floats to the integer type 'to' as TFLite does:
+ * q = clamp(round(x / scale) + zeroPoint), rounding half away from zero. NaN
+ * becomes the type's minimum. Returns false if 'to' is not an integer type.
+ */
+bool quantizeFloat32(const float *src, void *dst, ElementType to, float scale,
+                     int32_t zeroPoint, size_t count);
+
+/**
+ * Dequantize 'count' integers of type 'from' to floats: (q - zeroPoint) *
+ * scale. Returns false if 'from' is not an integer type.
+ */
+bool dequantizeToFloat32(const void *src, ElementType from, float *dst,
+                         float scale, int32_t zeroPoint, size_t count);
+
+/**
+ * The name of the instruction set used for vectorized conversions, e.g.
+ * "avx2", "sse2", "neon" or "scalar".
+ */
+const char *simdLevel();
+
+}  // namespace tensor_conversion
+
+#endif  // TFJS_TFLITE_NODE_TENSOR_CONVERSION_H_
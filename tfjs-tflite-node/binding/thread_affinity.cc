@@ -0,0 +1,157 @@
+/**
+ * @license
+ * Copyright 2022 Google LLC. All Rights Reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * =============================================================================
+ */
+
+#include "thread_affinity.h"
+
+#ifdef __linux__
+
+#include <fstream>
+#include <sstream>
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace thread_affinity {
+namespace {
+
+// Bits in Scope::previousNodes.
+const unsigned long kMaxNodes = 16 * 8 * sizeof(unsigned long);
+
+/**
+ * Parse a sysfs CPU list like "0-15,32-47".
+ */
+bool parseCpuList(const std::string &list, std::vector<int> *cpus) {
+  std::stringstream ranges(list);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+    int first = 0;
+    int last = 0;
+    char dash = 0;
+    std::stringstream parts(range);
+    if (!(parts >> first)) {
+      return false;
+    }
+    last = first;
+    if (parts >> dash && !(dash == '-' && parts >> last)) {
+      return false;
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus->push_back(cpu);
+    }
+  }
+  return true;
+}
+
+long setMemoryPolicy(int mode, const unsigned long *nodes,
+                     unsigned long maxNode) {
+  return syscall(SYS_set_mempolicy, mode, nodes, maxNode);
+}
+
+}  // namespace
+
+bool isSupported() {
+  return true;
+}
+
+std::string resolve(Placement *placement) {
+  if (placement->numaNode >= static_cast<int>(kMaxNodes)) {
+    return "NUMA node " + std::to_string(placement->numaNode)
+        + " is out of range";
+  }
+  if (placement->cpus.empty() && placement->numaNode >= 0) {
+    std::string path = "/sys/devices/system/node/node"
+        + std::to_string(placement->numaNode) + "/cpulist";
+    std::ifstream file(path);
+    std::string list;
+    if (!file || !std::getline(file, list)
+        || !parseCpuList(list, &placement->cpus)) {
+      return "NUMA node " + std::to_string(placement->numaNode)
+          + " does not exist";
+    }
+  }
+  for (int cpu : placement->cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      return "CPU " + std::to_string(cpu) + " is out of range";
+    }
+  }
+  return "";
+}
+
+Scope::Scope(const Placement &placement) {
+  if (!placement.cpus.empty()) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu : placement.cpus) {
+      CPU_SET(cpu, &cpus);
+    }
+    pthread_t self = pthread_self();
+    pinned = pthread_getaffinity_np(self, sizeof(previousCpus),
+                                    &previousCpus) == 0
+        && pthread_setaffinity_np(self, sizeof(cpus), &cpus) == 0;
+  }
+  if (placement.numaNode >= 0) {
+    unsigned long nodes[16] = {0};
+    int bits = 8 * sizeof(unsigned long);
+    nodes[placement.numaNode / bits] |= 1UL << (placement.numaNode % bits);
+    // Prefer the node rather than binding to it, so allocations still
+    // succeed when it runs out of memory.
+    bound = syscall(SYS_get_mempolicy, &previousMode, previousNodes,
+                    kMaxNodes, nullptr, 0) == 0
+        && setMemoryPolicy(MPOL_PREFERRED, nodes, kMaxNodes) == 0;
+  }
+}
+
+Scope::~Scope() {
+  if (bound) {
+    if (previousMode == MPOL_DEFAULT) {
+      setMemoryPolicy(MPOL_DEFAULT, nullptr, 0);
+    } else {
+      setMemoryPolicy(previousMode, previousNodes, kMaxNodes);
+    }
+  }
+  if (pinned) {
+    pthread_setaffinity_np(pthread_self(), sizeof(previousCpus),
+                           &previousCpus);
+  }
+}
+
+}  // namespace thread_affinity
+
+#else  // __linux__
+
+namespace thread_affinity {
+
+bool isSupported() {
+  return false;
+}
+
+std::string resolve(Placement *placement) {
+  return "Thread affinity is only supported on Linux";
+}
+
+Scope::Scope(const Placement &placement) { }
+
+Scope::~Scope() { }
+
+}  // namespace thread_affinity
+
+#endif  // __linux__
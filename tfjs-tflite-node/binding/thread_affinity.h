@@ -0,0 +1,84 @@
+/**
+ * @license
+ * Copyright 2022 Google LLC. All Rights Reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * =============================================================================
+ */
+
+#ifndef TFJS_TFLITE_NODE_THREAD_AFFINITY_H_
+#define TFJS_TFLITE_NODE_THREAD_AFFINITY_H_
+
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace thread_affinity {
+
+/**
+ * Where an interpreter's threads run and its memory comes from. An empty
+ * placement leaves both to the OS.
+ */
+struct Placement {
+  // CPUs the threads may run on.
+  std::vector<int> cpus;
+  // NUMA node to allocate memory on, or -1.
+  int numaNode = -1;
+
+  bool empty() const {
+    return cpus.empty() && numaNode < 0;
+  }
+};
+
+/**
+ * True if placements can be applied. Only Linux supports them.
+ */
+bool isSupported();
+
+/**
+ * Use the CPUs of the placement's NUMA node if it has no CPUs of its own, and
+ * check that they exist. Returns an error message, or an empty string on
+ * success.
+ */
+std::string resolve(Placement *placement);
+
+/**
+ * Applies a placement to the calling thread for the scope's lifetime. The
+ * thread is pinned to the placement's CPUs, which threads it creates (like
+ * TFLite's and XNNPACK's workers) inherit, and memory it first touches is
+ * allocated on the NUMA node. The thread's previous CPUs and memory policy
+ * are restored afterwards.
+ */
+class Scope {
+ public:
+  explicit Scope(const Placement &placement);
+  ~Scope();
+
+ private:
+  Scope(const Scope&) = delete;
+  Scope &operator=(const Scope&) = delete;
+
+#ifdef __linux__
+  bool pinned = false;
+  cpu_set_t previousCpus;
+  bool bound = false;
+  int previousMode = 0;
+  unsigned long previousNodes[16];
+#endif
+};
+
+}  // namespace thread_affinity
+
+#endif  // TFJS_TFLITE_NODE_THREAD_AFFINITY_H_
@@ -0,0 +1,183 @@
+/**
+ * @license
+ * Copyright 2022 Google LLC. All Rights Reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * =============================================================================
+ */
+
+import type {TypedArray} from '@tensorflow/tfjs-core';
+import type {TFLiteWebModelRunnerTensorInfo} from '@tensorflow/tfjs-tflite/dist/types/tflite_web_model_runner';
+
+/**
+ * The parts of a model runner that batching needs.
+ */
+export interface BatchableModelRunner {
+  getInputs(): TFLiteWebModelRunnerTensorInfo[];
+  getOutputs(): TFLiteWebModelRunnerTensorInfo[];
+  inferAsync(): Promise<boolean>;
+  resizeInput(index: number, shape: number[]): void;
+}
+
+export interface BatchingOptions {
+  /** The largest batch to run at once. Defaults to 8. */
+  maxBatchSize?: number;
+  /**
+   * How long the first request of a batch may wait for more requests, in
+   * milliseconds. Defaults to 2.
+   */
+  maxWaitMs?: number;
+}
+
+interface BatchRequest {
+  inputs: TypedArray[];
+  resolve: (outputs: TypedArray[]) => void;
+  reject: (error: Error) => void;
+}
+
+/**
+ * Groups concurrent single-example predict calls into batches.
+ *
+ * Requests are collected until either 'maxBatchSize' of them are waiting or
+ * the oldest has waited 'maxWaitMs'. The runner's inputs are then resized so
+ * that their first (batch) dimension matches the number of requests, one
+ * invoke is run, and each output row is returned to the request it belongs
+ * to.
+ *
+ * The model must accept a resizable batch dimension, and the runner must not
+ * be used by anything else while it is owned by the batcher.
+ */
+export class BatchingModelRunner {
+  private readonly maxBatchSize: number;
+  private readonly maxWaitMs: number;
+  // Shape of one example for each input, i.e. without the batch dimension.
+  private readonly exampleShapes: number[][];
+  private readonly queue: BatchRequest[] = [];
+  private batchSize = -1;
+  private running = false;
+  private timer?: ReturnType<typeof setTimeout>;
+
+  constructor(private readonly modelRunner: BatchableModelRunner,
+              options: BatchingOptions = {}) {
+    this.maxBatchSize = Math.max(1, options.maxBatchSize ?? 8);
+    this.maxWaitMs = Math.max(0, options.maxWaitMs ?? 2);
+    this.exampleShapes = modelRunner.getInputs().map(
+        input => input.shape.split(',').map(dim => Number(dim)).slice(1));
+  }
+
+  /** The number of requests waiting to be batched. */
+  get pending(): number {
+    return this.queue.length;
+  }
+
+  /**
+   * Runs inference on a single example.
+   *
+   * @param inputs One TypedArray per model input, holding the data of a
+   *     single example (batch size 1).
+   * @returns The outputs for this example.
+   */
+  predict(inputs: TypedArray[]): Promise<TypedArray[]> {
+    // Check inputs here so that one bad request does not fail a whole batch.
+    if (inputs.length !== this.exampleShapes.length) {
+      return Promise.reject(new Error(`Expected ${
+          this.exampleShapes.length} inputs but got ${inputs.length}`));
+    }
+    for (let i = 0; i < inputs.length; i++) {
+      const expected =
+          this.exampleShapes[i].reduce((size, dim) => size * dim, 1);
+      if (inputs[i].length !== expected) {
+        return Promise.reject(new Error(`Expected input ${i} to have ${
+            expected} elements but got ${inputs[i].length}`));
+      }
+    }
+    return new Promise((resolve, reject) => {
+      this.queue.push({inputs, resolve, reject});
+      this.schedule();
+    });
+  }
+
+  private schedule() {
+    if (this.running || this.queue.length === 0) {
+      return;
+    }
+    if (this.queue.length >= this.maxBatchSize) {
+      this.clearTimer();
+      this.runBatch();
+    } else if (this.timer == null) {
+      this.timer = setTimeout(() => {
+        this.timer = undefined;
+        this.runBatch();
+      }, this.maxWaitMs);
+    }
+  }
+
+  private clearTimer() {
+    if (this.timer != null) {
+      clearTimeout(this.timer);
+      this.timer = undefined;
+    }
+  }
+
+  private async runBatch() {
+    if (this.running || this.queue.length === 0) {
+      return;
+    }
+    this.running = true;
+    const batch = this.queue.splice(0, this.maxBatchSize);
+    try {
+      const outputs = await this.infer(batch);
+      batch.forEach((request, i) => request.resolve(outputs[i]));
+    } catch (e) {
+      batch.forEach(request => request.reject(e as Error));
+    } finally {
+      this.running = false;
+      this.schedule();
+    }
+  }
+
+  private async infer(batch: BatchRequest[]): Promise<TypedArray[][]> {
+    const n = batch.length;
+    if (n !== this.batchSize) {
+      // If a resize throws, some inputs may already have the new batch size,
+      // so force a full resize next time.
+      this.batchSize = -1;
+      this.exampleShapes.forEach((shape, i) => {
+        this.modelRunner.resizeInput(i, [n, ...shape]);
+      });
+      this.batchSize = n;
+    }
+
+    // Resizing replaces the data arrays, so get them after resizing.
+    const modelInputs = this.modelRunner.getInputs();
+    modelInputs.forEach((modelInput, i) => {
+      const data = modelInput.data();
+      const exampleLength = data.length / n;
+      batch.forEach((request, row) => {
+        data.set(request.inputs[i], row * exampleLength);
+      });
+    });
+
+    await this.modelRunner.inferAsync();
+
+    const results: TypedArray[][] = batch.map(() => []);
+    for (const modelOutput of this.modelRunner.getOutputs()) {
+      const data = modelOutput.data();
+      const exampleLength = data.length / n;
+      for (let row = 0; row < n; row++) {
+        results[row].push(
+            data.slice(row * exampleLength, (row + 1) * exampleLength));
+      }
+    }
+    return results;
+  }
+}
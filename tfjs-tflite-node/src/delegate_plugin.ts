@@ -33,6 +33,12 @@ export interface TFLiteDelegatePlugin {
   readonly options: Array<[string, string]>;
   readonly node?: {
     path: string;
+    /**
+     * Whether the delegate accepts 'serialization_dir' and 'model_token'
+     * options, like TFLite's GPU delegate, so that it can use the
+     * 'delegateCacheDir'.
+     */
+    serialization?: boolean;
   };
   readonly browser?: {
     url: string;
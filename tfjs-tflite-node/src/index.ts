@@ -15,10 +15,12 @@
  * =============================================================================
  */
 
-import type {TFLiteWebModelRunner, TFLiteWebModelRunnerOptions, TFLiteWebModelRunnerTensorInfo} from '@tensorflow/tfjs-tflite/dist/types/tflite_web_model_runner';
-import {TFHUB_SEARCH_PARAM, TFLiteModel} from './tflite_model';
-import * as fs from 'fs';
+import {DataType, ModelPredictConfig, ModelTensorInfo, NamedTensorMap, tensor, Tensor, TypedArray} from '@tensorflow/tfjs-core';
+import type {TFLiteDataType, TFLiteWebModelRunner, TFLiteWebModelRunnerOptions, TFLiteWebModelRunnerTensorInfo} from '@tensorflow/tfjs-tflite/dist/types/tflite_web_model_runner';
+import {getDTypeFromTFLiteType, TFHUB_SEARCH_PARAM, TFLiteModel} from './tflite_model';
+import * as path from 'path';
 
+export * from './batching';
 export * from './delegate_plugin';
 import {TFLiteDelegatePlugin} from './delegate_plugin';
 import fetch from 'node-fetch';
@@ -26,35 +28,524 @@ import fetch from 'node-fetch';
 // tslint:disable-next-line:no-require-imports
 const addon = require('bindings')('node_tflite_binding');
 
-interface InterpreterOptions {
+export interface InterpreterOptions {
   threads?: number;
-  delegate?: {
-    path: string;
-    options: Array<[string, string]>;
-  };
+  zeroCopy?: boolean;
+  lazyOutputs?: boolean;
+  shapeCacheSize?: number;
+  xnnpack?: boolean|XnnpackOptions;
+  affinity?: AffinityOptions;
+  /** A single external delegate. Ignored if 'delegates' is set. */
+  delegate?: ExternalDelegateOptions;
+  /**
+   * External delegates, applied in order before XNNPACK. Each one runs the
+   * operators it supports that earlier ones did not claim.
+   */
+  delegates?: ExternalDelegateOptions[];
+}
+
+/**
+ * Where an interpreter runs. Only supported on Linux; see 'threadAffinity'.
+ */
+export interface AffinityOptions {
+  /**
+   * CPUs that inference threads, TFLite's and XNNPACK's worker threads
+   * included, are pinned to. Defaults to the CPUs of 'numaNode'.
+   */
+  cpus?: number[];
+  /**
+   * NUMA node to allocate the model's copy and the tensor arena on. Models
+   * loaded from an ArrayBuffer are copied once per node.
+   */
+  numaNode?: number;
+}
+
+/**
+ * An external delegate library and the options it is created with.
+ */
+export interface ExternalDelegateOptions {
+  path: string;
+  options: Array<[string, string]>;
+  /**
+   * Directory passed to the delegate as its 'serialization_dir' option, along
+   * with a 'model_token'. Only set it for delegates that accept them, like
+   * TFLite's GPU delegate.
+   */
+  cacheDir?: string;
+}
+
+/**
+ * Configures the XNNPACK delegate the binding applies to an interpreter.
+ */
+export interface XnnpackOptions {
+  /** Threads for XNNPACK to use. Defaults to the interpreter's threads. */
+  threads?: number;
+  /** Also run signed and unsigned 8-bit quantized operators with XNNPACK. */
+  quantized?: boolean;
+}
+
+/**
+ * The model runner implemented by the node binding. In addition to the
+ * TFLiteWebModelRunner API, it can run inference without blocking the event
+ * loop.
+ */
+export interface TFLiteNodeTensorInfo extends TFLiteWebModelRunnerTensorInfo {
+  /**
+   * The tensor's shape as declared by the model, with -1 for dimensions that
+   * can be changed with resizeInput().
+   */
+  readonly shapeSignature: string;
+
+  /**
+   * Whether data() is TFLite's own tensor memory. False unless the runner was
+   * created with 'zeroCopy', and for tensors that fell back to copying, such
+   * as string tensors or tensors whose memory could not be shared.
+   */
+  readonly isZeroCopy: boolean;
+
+  /**
+   * Converts the elements of 'data' to the tensor's type and writes them into
+   * the tensor's data array, following the TypedArray conversion rules.
+   * 'data' must have as many elements as the tensor.
+   */
+  setData(data: TypedArray): void;
+
+  /**
+   * Returns a new array holding the tensor's elements converted to 'dtype'.
+   * 'bool' returns a Uint8Array of 0s and 1s, and 'float16' a Uint16Array of
+   * half precision bits. The data() of float16 tensors is a Uint16Array of
+   * such bits as well.
+   */
+  dataAs(dtype: 'int8'|'uint8'|'int16'|'int32'|'uint32'|'float16'|'float32'|
+         'float64'|'bool'): TypedArray;
+
+  /** The tensor's quantization parameters, or null if it isn't quantized. */
+  readonly quantization: {scale: number, zeroPoint: number}|null;
+
+  /**
+   * Quantizes 'data' with the tensor's scale and zero point and writes it into
+   * the tensor's data array. Values of tensors that are not quantized are
+   * converted to the tensor's type instead.
+   */
+  setFromFloat32(data: Float32Array): void;
+
+  /**
+   * Returns the tensor's data as a new Float32Array, dequantized if the
+   * tensor is quantized.
+   */
+  dataAsFloat32(): Float32Array;
+
+  /**
+   * Encodes the strings into a string tensor in a single call. Strings are
+   * encoded as UTF-8, and Uint8Arrays are used as they are. There must be one
+   * value per element of the tensor, so use resizeInput() to change their
+   * number.
+   */
+  setStrings(values: Array<string|Uint8Array>): void;
+
+  /** Decodes all the strings of a string tensor in a single call. */
+  getStrings(): string[];
+
+  /**
+   * Sets how setImage() converts pixels. The options are kept until they are
+   * set again.
+   */
+  setPreprocessing(options: ImagePreprocessingOptions): void;
+
+  /**
+   * Crops 'pixels' to 'crop', resizes them bilinearly to the tensor's height
+   * and width, normalizes them and writes them into the tensor's data array
+   * in a single native pass. The tensor must hold one NHWC image with 1 or 3
+   * channels. Integer tensors are quantized with the tensor's scale and zero
+   * point, or rounded and clamped if they are not quantized.
+   */
+  setImage(pixels: Uint8Array, width: number, height: number,
+           crop?: ImageRect): void;
+
+  /**
+   * Decodes a JPEG or PNG image on a worker thread and writes it into the
+   * tensor like setImage(), using the mean and std set with
+   * setPreprocessing(). The tensor must not be used until the returned
+   * promise resolves. Needs a binding built with image decoding, see
+   * 'imageDecoding'.
+   */
+  decodeImage(image: Uint8Array, options?: DecodeImageOptions): Promise<void>;
+}
+
+export interface DecodeImageOptions {
+  /**
+   * Downscale JPEGs by up to 8x while decoding, as long as they stay at least
+   * as large as the tensor. Much faster for large images. Defaults to false.
+   */
+  dctScaling?: boolean;
+  /**
+   * Reject images with more pixels than this before decoding them. Defaults
+   * to 2^26, about 67 megapixels.
+   */
+  maxPixels?: number;
+}
+
+/** Pixel layouts accepted by setImage(). YUV formats are 4:2:0, BT.601. */
+export type PixelFormat =
+    'rgb'|'rgba'|'bgr'|'bgra'|'gray'|'i420'|'nv12'|'nv21';
+
+export interface ImagePreprocessingOptions {
+  /** The layout of the pixels passed to setImage(). Defaults to 'rgb'. */
+  format?: PixelFormat;
+  /**
+   * Values are normalized as (pixel - mean) / std, per channel if arrays are
+   * given. Default to 0 and 1.
+   */
+  mean?: number|[number, number, number];
+  std?: number|[number, number, number];
+}
+
+export interface ImageRect {
+  x: number;
+  y: number;
+  width: number;
+  height: number;
+}
+
+/**
+ * Options for a single inference.
+ */
+export interface InferOptions {
+  /**
+   * Indices or names of the outputs to copy out of TFLite once inference
+   * finishes. Other outputs are only copied if their data() is read before
+   * the next inference. Without this, all outputs are copied unless the
+   * runner was created with 'lazyOutputs'.
+   */
+  outputs?: Array<number|string>;
+}
+
+export interface TFLiteNodeModelRunner extends TFLiteWebModelRunner {
+  getInputs(): TFLiteNodeTensorInfo[];
+  getOutputs(): TFLiteNodeTensorInfo[];
+
+  infer(options?: InferOptions): boolean;
+
+  /**
+   * Runs inference on a worker thread.
+   *
+   * Input data is read when this is called, so inputs can be refilled as soon
+   * as it returns. Outputs are updated when the returned promise resolves.
+   * The runner can not be used again until the promise settles.
+   *
+   * With 'zeroCopy', data arrays are TFLite's own tensor memory and are in
+   * use until the promise settles: data() and the set methods throw, and
+   * data arrays fetched earlier must not be written to.
+   */
+  inferAsync(options?: InferOptions): Promise<boolean>;
+
+  /**
+   * Resizes an input tensor and reallocates all tensors. Does nothing if the
+   * input already has the given shape. Inputs and outputs whose size changed
+   * get new data arrays, so fetch data() again after resizing.
+   */
+  resizeInput(index: number, shape: number[]): void;
+
+  /**
+   * Sets the class names topK() returns for an output, by class index. Pass
+   * null to remove them.
+   */
+  setLabels(output: number|string, labels: string[]|null): void;
+
+  /**
+   * Finds the 'k' highest scores of an output, highest first, by scanning its
+   * buffer natively instead of copying it to a tensor. Quantized scores are
+   * dequantized. 'labels' is set if setLabels() was called for the output.
+   */
+  topK(output: number|string, k: number): TopKResult;
+
+  /** Configures detect() for the model's box and score outputs. */
+  setDetection(options: DetectionOptions): void;
+
+  /**
+   * Decodes boxes, thresholds scores and runs NMS natively on the outputs set
+   * with setDetection(). Returns 6 values per detection, best first: yMin,
+   * xMin, yMax, xMax, score and class index.
+   */
+  detect(): Float32Array;
+}
+
+/**
+ * Post-processing for SSD style detection models, whose outputs hold 4 box
+ * values and a score per class for each box.
+ */
+export interface DetectionOptions {
+  /** The output holding the boxes, by index or name. */
+  boxes: number|string;
+  /** The output holding the class scores, by index or name. */
+  scores: number|string;
+  /**
+   * Anchors as (yCenter, xCenter, height, width) per box. Boxes are decoded
+   * relative to them. Without anchors, boxes are taken to be (yMin, xMin,
+   * yMax, xMax) already.
+   */
+  anchors?: Float32Array;
+  /**
+   * Divisors of the (y, x, height, width) box encodings. Defaults to
+   * [10, 10, 5, 5].
+   */
+  boxScale?: [number, number, number, number];
+  /** Boxes whose best score is not above this are dropped. Defaults to 0.5. */
+  scoreThreshold?: number;
+  /** Overlap above which greedy NMS drops a box. Defaults to 0.5. */
+  iouThreshold?: number;
+  /** Defaults to 100. */
+  maxDetections?: number;
+  /**
+   * 'greedy' (the default) drops overlapping boxes, and 'soft' decays their
+   * scores by exp(-iou^2 / softNmsSigma) instead.
+   */
+  nms?: 'greedy'|'soft';
+  /** Defaults to 0.5. */
+  softNmsSigma?: number;
+  /** Apply a sigmoid to the scores, which are logits. */
+  sigmoid?: boolean;
+  /** Ignore class 0, which is the background class. */
+  backgroundClass?: boolean;
+}
+
+export interface TopKResult {
+  indices: Int32Array;
+  scores: Float32Array;
+  labels?: string[];
 }
 
 // tslint:disable-next-line:variable-name
 export const TFLiteNodeModelRunner = addon.Interpreter as {
-  new(model: ArrayBuffer, options: InterpreterOptions): TFLiteWebModelRunner;
+  /**
+   * @param model The model content in memory (ArrayBuffer), or the path to a
+   *     model file (string), which is memory-mapped instead of being read. A
+   *     Uint8Array, such as a view of a SharedArrayBuffer passed to several
+   *     worker threads, is used in place without being copied and must not
+   *     be modified while interpreters use it, unless 'affinity.numaNode' is
+   *     set.
+   */
+  new(model: ArrayBuffer|Uint8Array|string, options: InterpreterOptions):
+      TFLiteNodeModelRunner;
+};
+
+/**
+ * Options for an interpreter pool. Every interpreter in the pool is created
+ * with the same interpreter options.
+ */
+export interface InterpreterPoolOptions extends InterpreterOptions {
+  /** Number of interpreters. Defaults to the number of CPU cores. */
+  size?: number;
+}
+
+/**
+ * A pool of interpreters over one shared model that runs concurrent predict
+ * calls on separate interpreters, off the main thread.
+ *
+ * Each running call occupies one thread of the libuv thread pool, so set
+ * UV_THREADPOOL_SIZE to at least the pool size to run them all at once.
+ */
+export interface TFLiteNodeInterpreterPool {
+  /** The number of interpreters in the pool. */
+  readonly size: number;
+  /** The number of calls waiting for a free interpreter. */
+  readonly pending: number;
+  /**
+   * Runs inference on the next free interpreter.
+   *
+   * @param inputs One TypedArray per model input, holding exactly the input's
+   *     bytes. They must not be modified until the returned promise settles.
+   * @returns Newly allocated copies of the model's outputs.
+   */
+  predict(inputs: TypedArray[]): Promise<TypedArray[]>;
+}
+
+// tslint:disable-next-line:variable-name
+export const TFLiteNodeInterpreterPool = addon.InterpreterPool as {
+  new(model: ArrayBuffer|Uint8Array|string, options: InterpreterPoolOptions):
+      TFLiteNodeInterpreterPool;
+};
+
+export interface InferenceStreamOptions {
+  /**
+   * Number of input and output buffer sets. With 3 and one stage, one frame
+   * can be filled and one read while another runs. Defaults to 3, and must
+   * be more than 'stages'.
+   */
+  buffers?: number;
+  /**
+   * Number of interpreters the stream runs frames on. Each has its own
+   * tensor arena and threads, and frames on different stages run at the
+   * same time, so one frame's copies overlap another's invoke. Defaults to 2.
+   */
+  stages?: number;
+  /**
+   * Number of frames that may wait for the interpreter. Submitting more drops
+   * the oldest waiting frame. Defaults to 1.
+   */
+  queueSize?: number;
+}
+
+/**
+ * Pipelined inference for video streams. Frames are filled into one of
+ * several buffer sets while other frames run, and copies to and from TFLite
+ * happen on the worker thread along with the invoke, so throughput can reach
+ * the invoke rate. Frames run on the stream's own interpreters for the
+ * runner's model, with the runner's input shapes when the stream was
+ * created, so the runner itself stays free to use.
+ */
+export interface InferenceStream {
+  /** The number of submitted frames waiting to run. */
+  readonly pending: number;
+  /** The number of frames dropped because newer frames arrived. */
+  readonly dropped: number;
+  /**
+   * Returns the input arrays to fill for the next frame. If every buffer set
+   * is busy, the oldest waiting frame is dropped to free one.
+   */
+  nextInputs(): TypedArray[];
+  /**
+   * Submits the frame filled through nextInputs(). Resolves with its output
+   * arrays, or null if the frame was dropped. The arrays are reused for later
+   * frames, so read them when the promise resolves.
+   */
+  submit(): Promise<TypedArray[]|null>;
+}
+
+// tslint:disable-next-line:variable-name
+export const InferenceStream = addon.InferenceStream as {
+  new(runner: TFLiteNodeModelRunner, options?: InferenceStreamOptions):
+      InferenceStream;
 };
 
 // tslint:disable-next-line:variable-name
 export const TensorInfo = addon.TensorInfo as {
-  new(): TFLiteWebModelRunnerTensorInfo;
+  new(): TFLiteNodeTensorInfo;
+};
+
+/**
+ * The instruction set the binding uses to convert tensor data between types:
+ * 'avx2', 'sse2', 'neon' or 'scalar'.
+ */
+export const simdLevel = addon.simdLevel as string;
+
+/**
+ * True if the binding was built with JPEG and PNG decoding for decodeImage().
+ */
+export const imageDecoding = addon.imageDecoding as boolean;
+
+/**
+ * True if interpreters can be pinned to CPUs and NUMA nodes with the
+ * 'affinity' option, which needs Linux.
+ */
+export const threadAffinity = addon.threadAffinity as boolean;
+
+/**
+ * True if the binding can apply its own XNNPACK delegate with the 'xnnpack'
+ * option. The macOS build of TFLite does not include it.
+ */
+export const xnnpack = addon.xnnpack as boolean;
+
+/**
+ * The process-wide inference thread budget and how it is being used.
+ */
+export interface ThreadBudget {
+  /** The most threads that run inference at once, or 0 for no limit. */
+  limit: number;
+  /** Threads of the inferences running now. */
+  running: number;
+  /** Inferences waiting for threads. */
+  waiting: number;
+  /** Live TFLite interpreters, and the threads they were created with. */
+  interpreters: number;
+  threads: number;
+}
+
+/**
+ * Caps the threads running inference at once across every interpreter in the
+ * process, including those of worker threads. Interpreters created afterwards
+ * get at most 'limit' threads, and each asynchronous inference is only
+ * started once its interpreter's threads fit in what running inferences
+ * leave. Synchronous infer() calls run at once, and count against the cap
+ * without waiting for it. 0 removes the cap.
+ */
+export const setThreadBudget = addon.setThreadBudget as (limit: number) => void;
+
+/**
+ * The current thread budget and allocation. See setThreadBudget().
+ */
+export const threadBudget = addon.threadBudget as () => ThreadBudget;
+
+/**
+ * Counts of models whose delegate found serialized data in its
+ * 'delegateCacheDir' (hits), and of those it had to compile (misses), across
+ * the process. Each model, delegate and options combination is counted once,
+ * by the first interpreter that applies the delegate.
+ */
+export const delegateCacheStats =
+    addon.delegateCacheStats as () => {hits: number, misses: number};
+
+/**
+ * Options for loading a model in Node.js.
+ */
+export type TFLiteNodeModelRunnerOptions = TFLiteWebModelRunnerOptions & {
+  delegates?: TFLiteDelegatePlugin[];
+  /**
+   * Back the input and output TensorInfo data arrays directly with TFLite's
+   * tensor memory so inference does not copy them. Outputs are then
+   * overwritten in place by the next inference, and data arrays must not be
+   * written while an inferAsync() is running.
+   */
+  zeroCopy?: boolean;
+  /**
+   * Only copy an output out of TFLite when its data is read, instead of
+   * copying every output after each inference. Outputs not read yet can't be
+   * read while an inferAsync() is running.
+   */
+  lazyOutputs?: boolean;
+  /**
+   * Number of previously used input shapes to keep allocated interpreters
+   * for. Each cached shape holds its own tensor arena (the model's weights
+   * are shared), so switching back to it is free. Defaults to 0, which
+   * reallocates tensors in place on every resize. This caps the number of
+   * shapes, not their memory, since TFLite does not report arena sizes.
+   */
+  shapeCacheSize?: number;
+  /**
+   * Directory where delegates that support serialization, like the GPU
+   * delegate, save their compiled graphs and load them on later runs instead
+   * of compiling again. Only delegates whose plugin sets
+   * 'node.serialization' use it. Entries are keyed by the model's contents,
+   * the delegate and its options. The directory is created if it does not
+   * exist.
+   */
+  delegateCacheDir?: string;
+  /**
+   * Apply an XNNPACK delegate configured by these options, after any other
+   * delegate, instead of the one TFLite applies by default. With 'true' it
+   * uses the default options. 'false' does not apply the binding's own
+   * delegate, but TFLite's default one still runs the floating-point
+   * operators it supports.
+   */
+  xnnpack?: boolean|XnnpackOptions;
+  /**
+   * Pin the interpreter's threads to a set of CPUs and allocate its memory on
+   * a NUMA node, for example to keep each interpreter on one socket.
+   */
+  affinity?: AffinityOptions;
 };
 
 async function createModel(model: string | ArrayBuffer,
-    options?: TFLiteWebModelRunnerOptions
-    & {delegates?: TFLiteDelegatePlugin[]}
-): Promise<TFLiteWebModelRunner> {
-  let modelData: ArrayBuffer;
+    options?: TFLiteNodeModelRunnerOptions
+): Promise<TFLiteNodeModelRunner> {
+  let modelData: ArrayBuffer|string;
 
   if (typeof model === 'string') {
     if (model.slice(0, 4) === 'http') {
       modelData = await (await fetch(model)).arrayBuffer();
     } else {
-      modelData = (await fs.promises.readFile(model)).buffer;
+      // Let the binding memory-map the file instead of reading it.
+      modelData = path.resolve(model);
     }
   }
   else {
@@ -63,25 +554,236 @@ async function createModel(model: string | ArrayBuffer,
 
   const interpreterOptions: InterpreterOptions = {
     threads: options?.numThreads ?? 4,
+    zeroCopy: options?.zeroCopy ?? false,
+    lazyOutputs: options?.lazyOutputs ?? false,
+    shapeCacheSize: options?.shapeCacheSize ?? 0,
+    xnnpack: options?.xnnpack ?? false,
+    affinity: options?.affinity,
   };
 
-  const firstDelegate = options?.delegates?.[0];
-  if (options?.delegates?.length > 1) {
-    console.warn('Only a single delegate is supported right now. Only the first '
-                 + `one, ${firstDelegate.name}, will be used`);
-  }
-  if (firstDelegate) {
-    const delegatePath = firstDelegate.node?.path;
+  // Delegates are applied in the order they are listed. Operators none of
+  // them support run on the CPU.
+  interpreterOptions.delegates = [];
+  for (const delegate of options?.delegates ?? []) {
+    const delegatePath = delegate.node?.path;
     if (delegatePath) {
-      interpreterOptions.delegate = {
+      interpreterOptions.delegates.push({
         path: delegatePath,
-        options: firstDelegate.options,
-      };
+        options: delegate.options,
+        cacheDir: delegate.node?.serialization ?
+            options?.delegateCacheDir : undefined,
+      });
     }
   }
   return new TFLiteNodeModelRunner(modelData, interpreterOptions);
 }
 
+/** TFLite data types, including those only the node binding supports. */
+type TFLiteNodeDataType = TFLiteDataType|'float16'|'string';
+
+/**
+ * The TFLiteModel loadTFLiteModel() returns. tflite_model.ts is kept in sync
+ * with tfjs-tflite, so what the node runner adds to it lives here: inputs
+ * with dynamic dimensions are resized to fit, float16 and string tensors are
+ * supported, data is converted natively and execute() only copies the
+ * outputs it returns.
+ */
+class TFLiteNodeModel extends TFLiteModel {
+  constructor(private readonly runner: TFLiteNodeModelRunner) {
+    super(runner);
+  }
+
+  get inputs(): ModelTensorInfo[] {
+    return this.getModelTensorInfos(this.runner.getInputs());
+  }
+
+  get outputs(): ModelTensorInfo[] {
+    return this.getModelTensorInfos(this.runner.getOutputs());
+  }
+
+  predict(inputs: Tensor|Tensor[]|NamedTensorMap, config?: ModelPredictConfig):
+      Tensor|Tensor[]|NamedTensorMap {
+    this.setInputs(inputs);
+    if (!this.runner.infer()) {
+      throw new Error('Failed running inference');
+    }
+
+    const outputTensors: NamedTensorMap = {};
+    for (const modelOutput of this.runner.getOutputs()) {
+      outputTensors[modelOutput.name] = this.getOutputTensor(modelOutput);
+    }
+    const names = Object.keys(outputTensors);
+    return names.length === 1 ? outputTensors[names[0]] : outputTensors;
+  }
+
+  execute(inputs: Tensor|Tensor[]|NamedTensorMap, outputs: string|string[]):
+      Tensor|Tensor[] {
+    const outputNames = Array.isArray(outputs) ? outputs : [outputs];
+    const modelOutputMap: {[name: string]: TFLiteNodeTensorInfo} = {};
+    this.runner.getOutputs().forEach(modelOutput => {
+      modelOutputMap[modelOutput.name] = modelOutput;
+    });
+    const missing = outputNames.filter(name => modelOutputMap[name] == null);
+    if (missing.length > 0) {
+      throw new Error(`Names not found in model outputs: [${missing}].`);
+    }
+
+    this.setInputs(inputs);
+    // Only copy the requested outputs out of TFLite.
+    if (!this.runner.infer({outputs: outputNames})) {
+      throw new Error('Failed running inference');
+    }
+
+    const outputTensors = outputNames.map(
+        name => this.getOutputTensor(modelOutputMap[name]));
+    return Array.isArray(outputs) ? outputTensors : outputTensors[0];
+  }
+
+  /**
+   * Checks all inputs, resizes the ones whose shape changed and only then
+   * writes them, since a resize reallocates every tensor.
+   */
+  private setInputs(inputs: Tensor|Tensor[]|NamedTensorMap) {
+    const pairs = this.matchInputs(inputs);
+    for (const [modelInput, input] of pairs) {
+      this.checkInput(modelInput, input);
+    }
+    for (const [modelInput, input] of pairs) {
+      if (modelInput.shape.split(',').length === input.rank &&
+          modelInput.shape !== input.shape.join(',')) {
+        this.runner.resizeInput(modelInput.id, input.shape);
+      }
+    }
+    for (const [modelInput, input] of pairs) {
+      if ((modelInput.dataType as TFLiteNodeDataType) === 'string') {
+        modelInput.setStrings(input.dataSync<'string'>());
+      } else {
+        modelInput.setData(input.dataSync());
+      }
+    }
+  }
+
+  private matchInputs(inputs: Tensor|Tensor[]|NamedTensorMap):
+      Array<[TFLiteNodeTensorInfo, Tensor]> {
+    const modelInputs = this.runner.getInputs();
+
+    // A single tensor or a tensor array.
+    if (inputs instanceof Tensor || Array.isArray(inputs)) {
+      const inputTensors = inputs instanceof Tensor ? [inputs] : inputs;
+      if (modelInputs.length !== inputTensors.length) {
+        throw new Error(`The size of TFLite model inputs (${
+            modelInputs
+                .length}) does not match the size of the input tensors (${
+            inputTensors.length})`);
+      }
+      return modelInputs.map(
+          (modelInput, i): [TFLiteNodeTensorInfo, Tensor] =>
+              [modelInput, inputTensors[i]]);
+    }
+
+    // Named tensors.
+    const modelInputMap: {[name: string]: TFLiteNodeTensorInfo} = {};
+    modelInputs.forEach(modelInput => {
+      modelInputMap[modelInput.name] = modelInput;
+    });
+    const inputTensorNames = Object.keys(inputs);
+    this.checkMapInputs(inputTensorNames, Object.keys(modelInputMap));
+    return inputTensorNames.map(
+        (name): [TFLiteNodeTensorInfo, Tensor] =>
+            [modelInputMap[name], inputs[name]]);
+  }
+
+  private checkInput(modelInput: TFLiteNodeTensorInfo, input: Tensor) {
+    if (input.dtype === 'complex64') {
+      throw new Error(`Data type '${input.dtype}' not supported.`);
+    }
+    const dataType = modelInput.dataType as TFLiteNodeDataType;
+    if ((input.dtype === 'string') !== (dataType === 'string')) {
+      throw this.getDataTypeMismatchError(dataType, input.dtype);
+    }
+
+    // Dimensions the model declares as -1 can be resized to fit.
+    const signature = modelInput.shapeSignature.split(',').map(Number);
+    if (!input.shape.every(
+            (dim, index) => signature[index] === -1 ||
+                signature[index] === dim)) {
+      throw new Error(`Input tensor shape mismatch: expect '${
+          modelInput.shapeSignature}', got '${input.shape.join(',')}'.`);
+    }
+
+    switch (dataType) {
+      case 'bool':
+      case 'int8':
+      case 'uint8':
+      case 'int16':
+      case 'uint32':
+      case 'int32':
+        if (input.dtype === 'float32') {
+          throw this.getDataTypeMismatchError(dataType, input.dtype);
+        } else if (dataType !== input.dtype) {
+          console.warn(`WARNING: converting '${input.dtype}' to '${
+              dataType}'`);
+        }
+        break;
+      case 'float16':
+      case 'float32':
+      case 'float64':
+        if (dataType !== input.dtype) {
+          console.warn(`WARNING: converting '${input.dtype}' to '${
+              dataType}'`);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  private getOutputTensor(modelOutput: TFLiteNodeTensorInfo): Tensor {
+    const shape = this.getShapeFromTFLiteTensorInfo(modelOutput);
+    // Convert TFLite tensor types that are not supported by TFJS to
+    // compatible types.
+    switch (modelOutput.dataType as TFLiteNodeDataType) {
+      case 'int8':
+      case 'int16':
+      case 'uint32':
+        return tensor(modelOutput.dataAs('int32'), shape);
+      case 'float16':
+        return tensor(modelOutput.dataAs('float32'), shape);
+      case 'float64':
+        console.warn(
+            `WARNING: converting output tensor from 'float64' to 'float32'`);
+        return tensor(modelOutput.dataAs('float32'), shape);
+      case 'string':
+        return tensor(modelOutput.getStrings(), shape, 'string');
+      default:
+        return tensor(modelOutput.data(), shape);
+    }
+  }
+
+  private getModelTensorInfos(infos: TFLiteNodeTensorInfo[]):
+      ModelTensorInfo[] {
+    return infos.map(info => {
+      let dtype: DataType;
+      switch (info.dataType as TFLiteNodeDataType) {
+        case 'float16':
+          dtype = 'float32';
+          break;
+        case 'string':
+          dtype = 'string';
+          break;
+        default:
+          dtype = getDTypeFromTFLiteType(info.dataType);
+          break;
+      }
+      return {
+        name: info.name,
+        shape: this.getShapeFromTFLiteTensorInfo(info),
+        dtype,
+      };
+    });
+  }
+}
+
 /**
  * Loads a TFLiteModel from the given model url or file.
  *
@@ -93,8 +795,7 @@ async function createModel(model: string | ArrayBuffer,
  */
 export async function loadTFLiteModel(
     model: string|ArrayBuffer,
-    options?: TFLiteWebModelRunnerOptions
-    & {delegates?: TFLiteDelegatePlugin[]}
+    options?: TFLiteNodeModelRunnerOptions
 ): Promise<TFLiteModel> {
   // Handle tfhub links.
   if (typeof model === 'string' && model.includes('tfhub.dev') &&
@@ -103,5 +804,5 @@ export async function loadTFLiteModel(
   }
 
   const tfliteModelRunner = await createModel(model, options);
-  return new TFLiteModel(tfliteModelRunner);
+  return new TFLiteNodeModel(tfliteModelRunner);
 }
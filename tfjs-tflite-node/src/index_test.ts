@@ -15,15 +15,20 @@
  * =============================================================================
  */
 
-import {loadTFLiteModel, TFLiteNodeModelRunner} from './index';
+import {BatchingModelRunner, delegateCacheStats, imageDecoding, InferenceStream, loadTFLiteModel, simdLevel, setThreadBudget, TFLiteNodeInterpreterPool, TFLiteNodeModelRunner, threadAffinity, threadBudget, xnnpack} from './index';
+import {execFileSync} from 'child_process';
 import * as fs from 'fs';
+import {tensor, Tensor} from '@tensorflow/tfjs-core';
 import {TFLiteWebModelRunner} from '@tensorflow/tfjs-tflite/dist/types/tflite_web_model_runner';
 import '@tensorflow/tfjs-backend-cpu';
 import * as jpeg from 'jpeg-js';
+import * as os from 'os';
+import * as path from 'path';
+import {Worker} from 'worker_threads';
 
 describe('interpreter', () => {
   let model: ArrayBuffer;
-  let modelRunner: TFLiteWebModelRunner;
+  let modelRunner: TFLiteNodeModelRunner;
   beforeEach(() => {
     model = fs.readFileSync('./test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite').buffer;
     modelRunner = new TFLiteNodeModelRunner(model, { threads: 4 });
@@ -53,6 +58,58 @@ describe('interpreter', () => {
     expect(outputs[0].data()).toBeDefined();
   });
 
+  it('runs inferAsync', async () => {
+    const outputs = modelRunner.getOutputs();
+    expect(await modelRunner.inferAsync()).toBeTrue();
+    expect(outputs[0].data()).toBeDefined();
+  });
+
+  it('throws if used while inferAsync is running', async () => {
+    const result = modelRunner.inferAsync();
+    expect(() => modelRunner.infer()).toThrowError(/busy/);
+    expect(() => modelRunner.inferAsync()).toThrowError(/busy/);
+    await result;
+  });
+
+  it('resizes an input', () => {
+    modelRunner.resizeInput(0, [2, 224, 224, 3]);
+    const input = modelRunner.getInputs()[0];
+    expect(input.shape).toEqual('2,224,224,3');
+    expect(input.data().length).toEqual(2 * 224 * 224 * 3);
+    modelRunner.infer();
+    expect(modelRunner.getOutputs()[0].shape.split(',')[0]).toEqual('2');
+  });
+
+  it('keeps the previous shape if tensors can not be allocated', () => {
+    // The first convolution expects 3 channels.
+    expect(() => modelRunner.resizeInput(0, [1, 224, 224, 1]))
+        .toThrowError(/allocate/);
+    const input = modelRunner.getInputs()[0];
+    expect(input.shape).toEqual('1,224,224,3');
+    expect(input.data().length).toEqual(224 * 224 * 3);
+    expect(modelRunner.infer()).toBeTrue();
+  });
+
+  it('does not reallocate when resizing to the same shape', () => {
+    const data = modelRunner.getInputs()[0].data();
+    modelRunner.resizeInput(0, [1, 224, 224, 3]);
+    expect(modelRunner.getInputs()[0].data()).toBe(data);
+  });
+
+  it('keeps the same TensorInfo objects after a resize', () => {
+    const input = modelRunner.getInputs()[0];
+    const output = modelRunner.getOutputs()[0];
+    modelRunner.resizeInput(0, [3, 224, 224, 3]);
+    expect(modelRunner.getInputs()[0]).toBe(input);
+    expect(modelRunner.getOutputs()[0]).toBe(output);
+    expect(output.shape.split(',')[0]).toEqual('3');
+  });
+
+  it('gets the input shape signature', () => {
+    const input = modelRunner.getInputs()[0];
+    expect(input.shapeSignature.split(',').length).toEqual(4);
+  });
+
   it('returns the same reference for each getInputs() call', () => {
     expect(modelRunner.getInputs()).toEqual(modelRunner.getInputs());
   });
@@ -78,6 +135,75 @@ describe('interpreter', () => {
     expect(output.name).toEqual('prediction');
   });
 
+  it('converts data written with setData', () => {
+    const input = modelRunner.getInputs()[0];
+    const values = new Int32Array(input.data().length).fill(300);
+    input.setData(values);
+    // 300 wraps to 44 in a uint8 tensor, as with Uint8Array.from().
+    expect(input.data()[0]).toEqual(44);
+    expect(input.data()[input.data().length - 1]).toEqual(44);
+  });
+
+  it('throws if setData gets the wrong number of elements', () => {
+    const input = modelRunner.getInputs()[0];
+    expect(() => input.setData(new Float32Array(3))).toThrowError(/elements/);
+  });
+
+  it('converts data read with dataAs', () => {
+    const input = modelRunner.getInputs()[0];
+    input.data().fill(200);
+    const converted = input.dataAs('int32');
+    expect(converted).toBeInstanceOf(Int32Array);
+    expect(converted.length).toEqual(input.data().length);
+    expect(converted[0]).toEqual(200);
+    expect(input.dataAs('int8')[0]).toEqual(-56);
+  });
+
+  it('gets quantization parameters', () => {
+    const quantization = modelRunner.getInputs()[0].quantization;
+    expect(quantization).not.toBeNull();
+    expect(quantization.scale).toBeGreaterThan(0);
+  });
+
+  it('quantizes with setFromFloat32 and dequantizes with dataAsFloat32', () => {
+    const input = modelRunner.getInputs()[0];
+    const {scale, zeroPoint} = input.quantization;
+    const values = new Float32Array(input.data().length).fill(scale * 10);
+    input.setFromFloat32(values);
+    expect(input.data()[0]).toEqual(zeroPoint + 10);
+    expect(input.dataAsFloat32()[0]).toBeCloseTo(scale * 10, 5);
+  });
+
+  it('writes preprocessed images into quantized inputs', () => {
+    const input = modelRunner.getInputs()[0];
+    input.setPreprocessing({format: 'rgba', mean: 127.5, std: 127.5});
+    const pixels = new Uint8Array(8 * 6 * 4);
+    for (let i = 0; i < pixels.length; i += 4) {
+      pixels.set([255, 0, 255, 255], i);
+    }
+    input.setImage(pixels, 8, 6);
+    const values = input.dataAsFloat32();
+    expect(values[0]).toBeCloseTo(1, 1);
+    expect(values[1]).toBeCloseTo(-1, 1);
+    expect(values[values.length - 1]).toBeCloseTo(1, 1);
+  });
+
+  it('throws if the image is smaller than its size', () => {
+    const input = modelRunner.getInputs()[0];
+    input.setPreprocessing({format: 'rgb'});
+    expect(() => input.setImage(new Uint8Array(10), 4, 4))
+        .toThrowError(/Expected at least 48 bytes/);
+  });
+
+  it('throws if strings are set on a numeric tensor', () => {
+    expect(() => modelRunner.getInputs()[0].setStrings(['a']))
+        .toThrowError(/not a string tensor/);
+  });
+
+  it('reports the SIMD level used for conversions', () => {
+    expect(['avx2', 'sse2', 'neon', 'scalar']).toContain(simdLevel);
+  });
+
   it('gets input tensor id', () => {
     const input = modelRunner.getInputs()[0];
     expect(input.id).toEqual(0);
@@ -115,7 +241,7 @@ function getMaxIndex(data: ArrayLike<number>) {
 
 describe('model', () => {
   let model: ArrayBuffer;
-  let modelRunner: TFLiteWebModelRunner;
+  let modelRunner: TFLiteNodeModelRunner;
   let parrot: Uint8Array;
   let labels: string[];
 
@@ -135,6 +261,262 @@ describe('model', () => {
     const label = labels[maxIndex];
     expect(label).toEqual('Ara macao (Scarlet Macaw)');
   });
+
+  it('decodes a JPEG image into an input', async () => {
+    if (!imageDecoding) {
+      pending('The binding was built without image decoding');
+    }
+    const input = modelRunner.getInputs()[0];
+    const {scale, zeroPoint} = input.quantization;
+    // Makes the quantized input equal to the pixel values.
+    input.setPreprocessing({mean: zeroPoint, std: 1 / scale});
+    await input.decodeImage(
+        fs.readFileSync('./test_data/parrot-small.jpg'));
+    modelRunner.infer();
+    const maxIndex = getMaxIndex(modelRunner.getOutputs()[0].data());
+    expect(labels[maxIndex]).toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('refuses to touch a tensor while decoding into it', async () => {
+    if (!imageDecoding) {
+      pending('The binding was built without image decoding');
+    }
+    const input = modelRunner.getInputs()[0];
+    const decoded =
+        input.decodeImage(fs.readFileSync('./test_data/parrot-small.jpg'));
+    expect(() => input.data()).toThrowError(/decoded/);
+    expect(() => input.setData(parrot)).toThrowError(/decoded/);
+    expect(() => input.setFromFloat32(new Float32Array(parrot.length)))
+        .toThrowError(/decoded/);
+    expect(() => input.dataAs('int32')).toThrowError(/decoded/);
+    expect(() => input.dataAsFloat32()).toThrowError(/decoded/);
+    await decoded;
+    expect(input.data().length).toEqual(parrot.length);
+  });
+
+  it('rejects images with more pixels than the limit', async () => {
+    if (!imageDecoding) {
+      pending('The binding was built without image decoding');
+    }
+    const input = modelRunner.getInputs()[0];
+    await expectAsync(input.decodeImage(
+        fs.readFileSync('./test_data/parrot-small.jpg'), {maxPixels: 100}))
+        .toBeRejectedWithError(/limit/);
+  });
+
+  it('finds the top scores with labels', () => {
+    modelRunner.getInputs()[0].data().set(parrot);
+    modelRunner.infer({outputs: []});
+    modelRunner.setLabels(0, labels);
+    const top = modelRunner.topK(0, 3);
+    expect(top.labels[0]).toEqual('Ara macao (Scarlet Macaw)');
+    expect(top.indices.length).toEqual(3);
+    expect(top.scores[0]).toBeGreaterThanOrEqual(top.scores[1]);
+    const scores = modelRunner.getOutputs()[0].dataAsFloat32();
+    expect(top.scores[0]).toEqual(scores.reduce((a, b) => Math.max(a, b)));
+  });
+
+  it('throws if detect() is not configured', () => {
+    expect(() => modelRunner.detect()).toThrowError(/setDetection/);
+  });
+
+  it('throws if detection outputs do not hold boxes', () => {
+    modelRunner.setDetection({boxes: 0, scores: 0});
+    modelRunner.infer();
+    expect(() => modelRunner.detect()).toThrowError(/4 box values/);
+  });
+
+  it('runs several interpreters created from the same model', () => {
+    const other = new TFLiteNodeModelRunner(model.slice(0), { threads: 1 });
+    for (const runner of [modelRunner, other]) {
+      runner.getInputs()[0].data().set(parrot);
+      runner.infer();
+      const maxIndex = getMaxIndex(runner.getOutputs()[0].data());
+      expect(labels[maxIndex]).toEqual('Ara macao (Scarlet Macaw)');
+    }
+  });
+
+  it('runs a model loaded from a file path', () => {
+    const runner = new TFLiteNodeModelRunner(
+        './test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite',
+        { threads: 4 });
+    runner.getInputs()[0].data().set(parrot);
+    runner.infer();
+    const maxIndex = getMaxIndex(runner.getOutputs()[0].data());
+    expect(labels[maxIndex]).toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('throws if the model file does not exist', () => {
+    expect(() => new TFLiteNodeModelRunner('./test_data/missing.tflite', {}))
+        .toThrowError(/missing.tflite/);
+  });
+
+  it('loads a TFLiteModel from a file path', async () => {
+    const tfliteModel = await loadTFLiteModel(
+        './test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite');
+    expect(tfliteModel.inputs.length).toEqual(1);
+  });
+
+  it('runs a model with inferAsync', async () => {
+    const input = modelRunner.getInputs()[0];
+    input.data().set(parrot);
+    await modelRunner.inferAsync();
+    const output = modelRunner.getOutputs()[0];
+    const maxIndex = getMaxIndex(output.data());
+    const label = labels[maxIndex];
+    expect(label).toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('dequantizes outputs', () => {
+    modelRunner.getInputs()[0].data().set(parrot);
+    modelRunner.infer();
+    const scores = modelRunner.getOutputs()[0].dataAsFloat32();
+    expect(labels[getMaxIndex(scores)]).toEqual('Ara macao (Scarlet Macaw)');
+    expect(scores[getMaxIndex(scores)]).toBeLessThanOrEqual(1);
+  });
+
+  it('copies lazy outputs when their data is read', () => {
+    const runner = new TFLiteNodeModelRunner(model, { lazyOutputs: true });
+    runner.getInputs()[0].data().set(parrot);
+    runner.infer();
+    const maxIndex = getMaxIndex(runner.getOutputs()[0].data());
+    expect(labels[maxIndex]).toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('refuses to read lazy outputs while inferAsync is running', async () => {
+    const runner = new TFLiteNodeModelRunner(model, { lazyOutputs: true });
+    const output = runner.getOutputs()[0];
+    runner.getInputs()[0].data().set(parrot);
+    runner.infer();
+    const result = runner.inferAsync();
+    expect(() => output.data()).toThrowError(/busy/);
+    expect(() => output.dataAsFloat32()).toThrowError(/busy/);
+    await result;
+    expect(labels[getMaxIndex(output.data())])
+        .toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('copies outputs selected by name', () => {
+    const output = modelRunner.getOutputs()[0];
+    modelRunner.getInputs()[0].data().set(parrot);
+    modelRunner.infer({outputs: [output.name]});
+    expect(labels[getMaxIndex(output.data())])
+        .toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('throws if a selected output does not exist', () => {
+    expect(() => modelRunner.infer({outputs: ['missing']}))
+        .toThrowError(/missing/);
+    expect(() => modelRunner.infer({outputs: [1]})).toThrowError(/range/);
+  });
+
+  it('rejects string tensors for numeric inputs', async () => {
+    const tfliteModel = await loadTFLiteModel(model);
+    const input = tensor(['a'], [1], 'string');
+    expect(() => tfliteModel.predict(input)).toThrowError(/mismatch/);
+  });
+
+  it('executes a TFLiteModel for a named output', async () => {
+    const tfliteModel = await loadTFLiteModel(model);
+    const name = tfliteModel.outputs[0].name;
+    const input = tensor(parrot, [1, 224, 224, 3], 'int32');
+    const output = tfliteModel.execute(input, name) as Tensor;
+    expect(labels[getMaxIndex(output.dataSync())])
+        .toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('runs quantized operators with the XNNPACK delegate', () => {
+    if (!xnnpack) {
+      pending('The binding was built without the XNNPACK delegate');
+    }
+    const runner = new TFLiteNodeModelRunner(
+        model, {threads: 2, xnnpack: {quantized: true}});
+    runner.getInputs()[0].data().set(parrot);
+    runner.infer();
+    expect(labels[getMaxIndex(runner.getOutputs()[0].data())])
+        .toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('runs pinned to a NUMA node', () => {
+    if (!threadAffinity) {
+      pending('Thread affinity is only supported on Linux');
+    }
+    const runner = new TFLiteNodeModelRunner(
+        model, {threads: 2, affinity: {numaNode: 0}});
+    runner.getInputs()[0].data().set(parrot);
+    runner.infer();
+    expect(labels[getMaxIndex(runner.getOutputs()[0].data())])
+        .toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('rejects CPUs that do not exist', () => {
+    expect(() => new TFLiteNodeModelRunner(model, {affinity: {cpus: [-1]}}))
+        .toThrowError(threadAffinity ? /out of range/ : /Linux/);
+  });
+
+  it('names the delegate that could not be created', () => {
+    expect(() => new TFLiteNodeModelRunner(model, {
+      delegates: [{path: 'missing_delegate.so', options: []}],
+    })).toThrowError(/missing_delegate\.so/);
+  });
+
+  it('only counts delegate cache lookups for delegates', async () => {
+    const before = delegateCacheStats();
+    await loadTFLiteModel(model, {delegateCacheDir: 'delegate_cache'});
+    expect(delegateCacheStats()).toEqual(before);
+  });
+
+  it('reports a delegate cache directory it can not create', async () => {
+    const delegate = {
+      name: 'serializing delegate',
+      tfliteVersion: '2.8',
+      options: [] as Array<[string, string]>,
+      node: {path: 'missing_delegate.so', serialization: true},
+    };
+    await expectAsync(loadTFLiteModel(model, {
+      delegates: [delegate],
+      delegateCacheDir: './test_data/COPYRIGHT/delegate_cache',
+    })).toBeRejectedWithError(/delegate cache directory/);
+  });
+
+  it('misses the delegate cache once, then hits it on the next run', () => {
+    // A delegate that supports serialization, like TFLite's GPU delegate.
+    const delegatePath = process.env['TFLITE_SERIALIZING_DELEGATE'];
+    if (!delegatePath) {
+      pending('Set TFLITE_SERIALIZING_DELEGATE to a delegate library');
+    }
+    const cacheDir = fs.mkdtempSync(path.join(os.tmpdir(), 'delegate_cache'));
+    const script = `
+      const {delegateCacheStats, loadTFLiteModel, TFLiteNodeInterpreterPool} =
+          require(process.env.INDEX);
+      const delegate = {name: 'delegate', tfliteVersion: '2.8', options: [],
+                        node: {path: process.env.DELEGATE, serialization: true}};
+      const cacheDir = process.env.CACHE_DIR;
+      const modelPath = process.env.MODEL;
+      loadTFLiteModel(modelPath, {delegates: [delegate],
+                                  delegateCacheDir: cacheDir})
+          .then(() => {
+            // Pool members reuse the first interpreter's compiled graph.
+            new TFLiteNodeInterpreterPool(modelPath, {
+              size: 2,
+              delegates: [{path: delegate.node.path, options: [], cacheDir}],
+            });
+            console.log(JSON.stringify(delegateCacheStats()));
+          });
+    `;
+    const env = {
+      ...process.env,
+      INDEX: path.join(__dirname, 'index'),
+      DELEGATE: delegatePath,
+      CACHE_DIR: cacheDir,
+      MODEL: path.resolve(
+          './test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite'),
+    };
+    const run = () => JSON.parse(
+        execFileSync(process.execPath, ['-e', script], {env}).toString());
+    expect(run()).toEqual({hits: 0, misses: 1});
+    expect(run()).toEqual({hits: 1, misses: 0});
+  });
 });
 
 describe('float32 support', () => {
@@ -176,6 +558,534 @@ describe('float32 support', () => {
     const label = labels[maxIndex];
     expect(label).toEqual('class2');
   });
+
+  it('crops images written with setImage', () => {
+    const input = (modelRunner as TFLiteNodeModelRunner).getInputs()[0];
+    input.setPreprocessing({format: 'bgr'});
+    // A blue left half and a red right half.
+    const pixels = new Uint8Array(4 * 2 * 3);
+    for (let x = 0; x < 4; x++) {
+      for (let y = 0; y < 2; y++) {
+        pixels[(y * 4 + x) * 3 + (x < 2 ? 0 : 2)] = 255;
+      }
+    }
+    input.setImage(pixels, 4, 2, {x: 2, y: 0, width: 2, height: 2});
+    expect(input.data().slice(0, 3)).toEqual(new Float32Array([255, 0, 0]));
+  });
+
+  it('converts float32 data to and from float16', () => {
+    const input = (modelRunner as TFLiteNodeModelRunner).getInputs()[0];
+    input.data().set([1, -2, 65504, 1e6]);
+    const half = input.dataAs('float16');
+    expect(half).toBeInstanceOf(Uint16Array);
+    expect(Array.from(half.slice(0, 4))).toEqual([
+      0x3c00, 0xc000, 0x7bff, 0x7c00
+    ]);
+  });
+});
+
+describe('detection', () => {
+  let modelRunner: TFLiteNodeModelRunner;
+  // Boxes 0 and 1 overlap with an IoU of 2/3, box 2 overlaps neither and box
+  // 3 lies inside box 0, with an IoU of 1/4.
+  const boxes = [
+    0, 0, 0.5, 0.5,
+    0, 0.1, 0.5, 0.6,
+    0.5, 0.5, 1, 1,
+    0, 0, 0.25, 0.25,
+  ];
+  // 3 classes per box, of which class 0 is the background.
+  const scores = [
+    0.1, 0.9, 0.2,
+    0.1, 0.3, 0.8,
+    0.2, 0.1, 0.7,
+    0.95, 0.1, 0.2,
+  ];
+
+  beforeEach(() => {
+    const model = fs.readFileSync('./test_data/detection_passthrough.tflite')
+      .buffer;
+    modelRunner = new TFLiteNodeModelRunner(model, {});
+  });
+
+  function run(boxValues: number[], scoreValues: number[]): Float32Array {
+    const [boxesInput, scoresInput] = modelRunner.getInputs();
+    boxesInput.data().set(boxValues);
+    scoresInput.data().set(scoreValues);
+    modelRunner.infer();
+    return modelRunner.detect();
+  }
+
+  function expectDetections(actual: Float32Array, expected: number[][]) {
+    expect(actual.length).toEqual(expected.length * 6);
+    expected.forEach((values, i) => {
+      values.forEach((value, j) => {
+        expect(actual[i * 6 + j]).toBeCloseTo(value, 5);
+      });
+    });
+  }
+
+  it('drops boxes that overlap a better one with greedy NMS', () => {
+    modelRunner.setDetection(
+        {boxes: 'boxes_out', scores: 'scores_out', backgroundClass: true});
+    expectDetections(run(boxes, scores), [
+      [0, 0, 0.5, 0.5, 0.9, 1],
+      [0.5, 0.5, 1, 1, 0.7, 2],
+    ]);
+  });
+
+  it('detects the background class unless it is ignored', () => {
+    modelRunner.setDetection({boxes: 0, scores: 1});
+    expectDetections(run(boxes, scores), [
+      [0, 0, 0.25, 0.25, 0.95, 0],
+      [0, 0, 0.5, 0.5, 0.9, 1],
+      [0.5, 0.5, 1, 1, 0.7, 2],
+    ]);
+  });
+
+  it('decays the scores of overlapping boxes with soft NMS', () => {
+    const options = {
+      boxes: 0,
+      scores: 1,
+      scoreThreshold: 0.3,
+      backgroundClass: true
+    };
+    modelRunner.setDetection({...options, nms: 'greedy'});
+    expectDetections(run(boxes, scores), [
+      [0, 0, 0.5, 0.5, 0.9, 1],
+      [0.5, 0.5, 1, 1, 0.7, 2],
+    ]);
+    // The IoU of 2/3 with box 0 decays box 1 by exp(-(2/3)^2 / 0.5).
+    modelRunner.setDetection({...options, nms: 'soft', softNmsSigma: 0.5});
+    expectDetections(modelRunner.detect(), [
+      [0, 0, 0.5, 0.5, 0.9, 1],
+      [0.5, 0.5, 1, 1, 0.7, 2],
+      [0, 0.1, 0.5, 0.6, 0.8 * Math.exp(-(4 / 9) / 0.5), 2],
+    ]);
+  });
+
+  it('thresholds logits and applies a sigmoid to the kept scores', () => {
+    const logits = scores.map(p => Math.log(p / (1 - p)));
+    for (const nms of ['greedy', 'soft'] as const) {
+      modelRunner.setDetection({
+        boxes: 0,
+        scores: 1,
+        nms,
+        sigmoid: true,
+        backgroundClass: true
+      });
+      expectDetections(run(boxes, logits), [
+        [0, 0, 0.5, 0.5, 0.9, 1],
+        [0.5, 0.5, 1, 1, 0.7, 2],
+      ]);
+    }
+  });
+
+  it('decodes boxes relative to anchors', () => {
+    // Every anchor is centered at (0.5, 0.5) and is 0.2 high and 0.4 wide.
+    const anchors = new Float32Array(16);
+    for (let i = 0; i < 16; i += 4) {
+      anchors.set([0.5, 0.5, 0.2, 0.4], i);
+    }
+    const encoded: number[] = new Array(16).fill(0);
+    encoded.splice(0, 4, 1, -2, 5 * Math.log(2), 0);
+    const onlyFirst: number[] = new Array(12).fill(0);
+    onlyFirst[1] = 0.9;
+    for (const nms of ['greedy', 'soft'] as const) {
+      modelRunner.setDetection({boxes: 0, scores: 1, anchors, nms});
+      // The center moves by (1 / 10 * 0.2, -2 / 10 * 0.4) and the height
+      // doubles.
+      expectDetections(run(encoded, onlyFirst), [
+        [0.32, 0.22, 0.72, 0.62, 0.9, 1],
+      ]);
+    }
+  });
+});
+
+describe('string tensors', () => {
+  const modelPath = './test_data/string_passthrough.tflite';
+  let modelRunner: TFLiteNodeModelRunner;
+
+  beforeEach(() => {
+    modelRunner =
+        new TFLiteNodeModelRunner(fs.readFileSync(modelPath).buffer, {});
+  });
+
+  it('round-trips strings through a model', () => {
+    const input = modelRunner.getInputs()[0];
+    expect(input.dataType as string).toEqual('string');
+    input.setStrings(['h\u00e9llo', new Uint8Array([0xe2, 0x82, 0xac])]);
+    expect(input.getStrings()).toEqual(['h\u00e9llo', '\u20ac']);
+    modelRunner.infer();
+    expect(modelRunner.getOutputs()[0].getStrings())
+        .toEqual(['h\u00e9llo', '\u20ac']);
+  });
+
+  it('round-trips empty strings', () => {
+    modelRunner.getInputs()[0].setStrings(['', 'a']);
+    modelRunner.infer();
+    expect(modelRunner.getOutputs()[0].getStrings()).toEqual(['', 'a']);
+  });
+
+  it('throws if the number of strings does not match the shape', () => {
+    expect(() => modelRunner.getInputs()[0].setStrings(['a']))
+        .toThrowError(/Expected 2 strings but got 1/);
+  });
+
+  it('predicts string tensors with a TFLiteModel', async () => {
+    const tfliteModel = await loadTFLiteModel(modelPath);
+    expect(tfliteModel.inputs[0].dtype).toEqual('string');
+    const output =
+        tfliteModel.predict(tensor(['one', 'two'], [2], 'string')) as Tensor;
+    expect(output.dtype).toEqual('string');
+    expect(output.shape).toEqual([2]);
+    expect(output.arraySync()).toEqual(['one', 'two']);
+  });
+});
+
+describe('inference stream', () => {
+  let modelRunner: TFLiteNodeModelRunner;
+  let parrot: Uint8Array;
+  let labels: string[];
+
+  beforeEach(() => {
+    const model = fs.readFileSync('./test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite').buffer;
+    modelRunner = new TFLiteNodeModelRunner(model, {});
+    parrot = getParrot();
+    labels = fs.readFileSync('./test_data/inat_bird_labels.txt', 'utf-8').split(/\r?\n/);
+  });
+
+  it('runs submitted frames', async () => {
+    const stream = new InferenceStream(modelRunner, {buffers: 3});
+    stream.nextInputs()[0].set(parrot);
+    const outputs = await stream.submit();
+    expect(labels[getMaxIndex(outputs[0])])
+        .toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('drops the oldest waiting frame', async () => {
+    const stream = new InferenceStream(modelRunner, {buffers: 3, stages: 1});
+    const results = [0, 1, 2].map(() => {
+      stream.nextInputs()[0].set(parrot);
+      return stream.submit();
+    });
+    const [first, second, third] = await Promise.all(results);
+    expect(first).not.toBeNull();
+    expect(second).toBeNull();
+    expect(third).not.toBeNull();
+    expect(stream.dropped).toEqual(1);
+  });
+
+  it('runs frames on several stages at once', async () => {
+    const stream = new InferenceStream(modelRunner, {buffers: 3, stages: 2});
+    const results = [0, 1].map(() => {
+      stream.nextInputs()[0].set(parrot);
+      return stream.submit();
+    });
+    expect(stream.pending).toEqual(0);
+    for (const outputs of await Promise.all(results)) {
+      expect(labels[getMaxIndex(outputs[0])])
+          .toEqual('Ara macao (Scarlet Macaw)');
+    }
+  });
+
+  it('runs frames while the runner is busy', async () => {
+    const stream = new InferenceStream(modelRunner);
+    const inference = modelRunner.inferAsync();
+    stream.nextInputs()[0].set(parrot);
+    const outputs = await stream.submit();
+    await inference;
+    expect(labels[getMaxIndex(outputs[0])])
+        .toEqual('Ara macao (Scarlet Macaw)');
+  });
+});
+
+describe('interpreter pool', () => {
+  let pool: TFLiteNodeInterpreterPool;
+  let parrot: Uint8Array;
+  let labels: string[];
+
+  beforeEach(() => {
+    const model = fs.readFileSync('./test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite').buffer;
+    pool = new TFLiteNodeInterpreterPool(model, { size: 2, threads: 1 });
+    parrot = getParrot();
+    labels = fs.readFileSync('./test_data/inat_bird_labels.txt', 'utf-8').split(/\r?\n/);
+  });
+
+  it('has the requested number of interpreters', () => {
+    expect(pool.size).toEqual(2);
+  });
+
+  it('runs concurrent predict calls', async () => {
+    const results = await Promise.all(
+        [0, 1, 2, 3, 4].map(() => pool.predict([parrot])));
+    for (const outputs of results) {
+      expect(labels[getMaxIndex(outputs[0])])
+          .toEqual('Ara macao (Scarlet Macaw)');
+    }
+    expect(pool.pending).toEqual(0);
+  });
+
+  it('returns separate output arrays for each call', async () => {
+    const [a, b] = await Promise.all([pool.predict([parrot]),
+                                      pool.predict([parrot])]);
+    expect(a[0]).not.toBe(b[0]);
+  });
+
+  it('rejects inputs of the wrong size', async () => {
+    await expectAsync(pool.predict([new Uint8Array(3)]))
+        .toBeRejectedWithError(/bytes/);
+  });
+
+  it('rejects inputs of the wrong type', async () => {
+    await expectAsync(pool.predict([new Int8Array(parrot.buffer)]))
+        .toBeRejectedWithError(/type/);
+  });
+});
+
+describe('batching', () => {
+  let batcher: BatchingModelRunner;
+  let parrot: Uint8Array;
+  let labels: string[];
+
+  beforeEach(() => {
+    const model = fs.readFileSync('./test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite').buffer;
+    const modelRunner = new TFLiteNodeModelRunner(model, { threads: 4 });
+    batcher = new BatchingModelRunner(modelRunner,
+                                      { maxBatchSize: 4, maxWaitMs: 10 });
+    parrot = getParrot();
+    labels = fs.readFileSync('./test_data/inat_bird_labels.txt', 'utf-8').split(/\r?\n/);
+  });
+
+  it('batches concurrent requests', async () => {
+    const results = await Promise.all(
+        [0, 1, 2, 3, 4, 5].map(() => batcher.predict([parrot])));
+    expect(results.length).toEqual(6);
+    for (const outputs of results) {
+      expect(labels[getMaxIndex(outputs[0])])
+          .toEqual('Ara macao (Scarlet Macaw)');
+    }
+    expect(batcher.pending).toEqual(0);
+  });
+
+  it('runs a single request after the wait time', async () => {
+    const [scores] = await batcher.predict([parrot]);
+    expect(labels[getMaxIndex(scores)]).toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('rejects inputs of the wrong size', async () => {
+    await expectAsync(batcher.predict([new Uint8Array(3)]))
+        .toBeRejectedWithError(/elements/);
+  });
+});
+
+describe('shape cache', () => {
+  let modelRunner: TFLiteNodeModelRunner;
+  let parrot: Uint8Array;
+  let labels: string[];
+
+  beforeEach(() => {
+    const model = fs.readFileSync('./test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite').buffer;
+    modelRunner = new TFLiteNodeModelRunner(
+        model, { threads: 4, shapeCacheSize: 2 });
+    parrot = getParrot();
+    labels = fs.readFileSync('./test_data/inat_bird_labels.txt', 'utf-8').split(/\r?\n/);
+  });
+
+  it('reuses data arrays when switching back to a cached shape', () => {
+    const data = modelRunner.getInputs()[0].data();
+    modelRunner.resizeInput(0, [2, 224, 224, 3]);
+    expect(modelRunner.getInputs()[0].data()).not.toBe(data);
+    modelRunner.resizeInput(0, [1, 224, 224, 3]);
+    expect(modelRunner.getInputs()[0].data()).toBe(data);
+  });
+
+  it('runs inference after switching shapes', () => {
+    modelRunner.resizeInput(0, [2, 224, 224, 3]);
+    const input = modelRunner.getInputs()[0].data();
+    input.set(parrot);
+    input.set(parrot, parrot.length);
+    modelRunner.infer();
+    const output = modelRunner.getOutputs()[0].data();
+    const classes = output.length / 2;
+    expect(labels[getMaxIndex(output.slice(classes))])
+        .toEqual('Ara macao (Scarlet Macaw)');
+
+    modelRunner.resizeInput(0, [1, 224, 224, 3]);
+    modelRunner.getInputs()[0].data().set(parrot);
+    modelRunner.infer();
+    expect(labels[getMaxIndex(modelRunner.getOutputs()[0].data())])
+        .toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('evicts the least recently used shape', () => {
+    const data = modelRunner.getInputs()[0].data();
+    modelRunner.resizeInput(0, [2, 224, 224, 3]);
+    modelRunner.resizeInput(0, [3, 224, 224, 3]);
+    modelRunner.resizeInput(0, [4, 224, 224, 3]);
+    modelRunner.resizeInput(0, [1, 224, 224, 3]);
+    expect(modelRunner.getInputs()[0].data()).not.toBe(data);
+  });
+});
+
+describe('zero-copy mode', () => {
+  let model: ArrayBuffer;
+  let modelRunner: TFLiteNodeModelRunner;
+  let parrot: Uint8Array;
+  let labels: string[];
+
+  beforeEach(() => {
+    model = fs.readFileSync('./test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite').buffer;
+    modelRunner = new TFLiteNodeModelRunner(model, { threads: 4, zeroCopy: true });
+    parrot = getParrot();
+    labels = fs.readFileSync('./test_data/inat_bird_labels.txt', 'utf-8').split(/\r?\n/);
+  });
+
+  it('runs a model', () => {
+    modelRunner.getInputs()[0].data().set(parrot);
+    modelRunner.infer();
+    const maxIndex = getMaxIndex(modelRunner.getOutputs()[0].data());
+    expect(labels[maxIndex]).toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('reports which tensors share TFLite memory', () => {
+    expect(modelRunner.getInputs()[0].isZeroCopy).toBeTrue();
+    expect(modelRunner.getOutputs()[0].isZeroCopy).toBeTrue();
+  });
+
+  it('updates outputs in place', () => {
+    const output = modelRunner.getOutputs()[0].data();
+    modelRunner.getInputs()[0].data().set(parrot);
+    modelRunner.infer();
+    expect(labels[getMaxIndex(output)]).toEqual('Ara macao (Scarlet Macaw)');
+  });
+
+  it('refuses to touch tensor memory while inferAsync is running', async () => {
+    const input = modelRunner.getInputs()[0];
+    const result = modelRunner.inferAsync();
+    const output = modelRunner.getOutputs()[0];
+    expect(() => input.data()).toThrowError(/busy/);
+    expect(() => input.setData(parrot)).toThrowError(/busy/);
+    expect(() => output.dataAs('float32')).toThrowError(/busy/);
+    expect(() => output.dataAsFloat32()).toThrowError(/busy/);
+    await result;
+    expect(input.data()).toBeDefined();
+    expect(output.dataAsFloat32().length).toEqual(output.data().length);
+  });
+
+  it('can create several interpreters over the same model', () => {
+    const other = new TFLiteNodeModelRunner(model, { zeroCopy: true });
+    other.getInputs()[0].data().set(parrot);
+    other.infer();
+    expect(labels[getMaxIndex(other.getOutputs()[0].data())])
+        .toEqual('Ara macao (Scarlet Macaw)');
+  });
+});
+
+describe('thread budget', () => {
+  const modelPath = './test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite';
+
+  afterEach(() => {
+    setThreadBudget(0);
+  });
+
+  it('caps the threads of new interpreters', () => {
+    setThreadBudget(2);
+    const before = threadBudget().threads;
+    const runner = new TFLiteNodeModelRunner(modelPath, {threads: 8});
+    expect(threadBudget().threads - before).toEqual(2);
+    runner.infer();
+    expect(threadBudget().running).toEqual(0);
+  });
+
+  it('runs concurrent inferences within the budget', async () => {
+    setThreadBudget(1);
+    const runners = [0, 1, 2].map(
+        () => new TFLiteNodeModelRunner(modelPath, {threads: 1}));
+    await Promise.all(runners.map(runner => runner.inferAsync()));
+    const budget = threadBudget();
+    expect(budget.limit).toEqual(1);
+    expect(budget.running).toEqual(0);
+    expect(budget.waiting).toEqual(0);
+  });
+
+  it('runs synchronous inferences while others wait', async () => {
+    setThreadBudget(1);
+    const runners = [0, 1, 2].map(
+        () => new TFLiteNodeModelRunner(modelPath, {threads: 1}));
+    const inferences = Promise.all(runners.map(runner => runner.inferAsync()));
+    // Doesn't wait for the budget, which the first inference holds.
+    new TFLiteNodeModelRunner(modelPath, {threads: 1}).infer();
+    await inferences;
+    expect(threadBudget().running).toEqual(0);
+    expect(threadBudget().waiting).toEqual(0);
+  });
+});
+
+describe('worker threads', () => {
+  it('runs interpreters in several workers at once', async () => {
+    const modelPath = './test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite';
+    const script = `
+      const {parentPort, workerData} = require('worker_threads');
+      const {TFLiteNodeModelRunner} = require(workerData.index);
+      const runner = new TFLiteNodeModelRunner(workerData.modelPath, {});
+      runner.infer();
+      parentPort.postMessage(runner.getOutputs()[0].data().length);
+    `;
+    const runWorker = () => new Promise((resolve, reject) => {
+      const worker = new Worker(script, {
+        eval: true,
+        workerData: {index: path.join(__dirname, 'index'), modelPath},
+      });
+      worker.on('message', resolve);
+      worker.on('error', reject);
+    });
+
+    const expected = new TFLiteNodeModelRunner(modelPath, {})
+        .getOutputs()[0].data().length;
+    const lengths = await Promise.all([runWorker(), runWorker()]);
+    expect(lengths).toEqual([expected, expected]);
+  });
+
+  it('builds interpreters over a SharedArrayBuffer', async () => {
+    const bytes = fs.readFileSync(
+        './test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite');
+    const shared = new SharedArrayBuffer(bytes.length);
+    new Uint8Array(shared).set(bytes);
+    const script = `
+      const {parentPort, workerData} = require('worker_threads');
+      const {TFLiteNodeModelRunner} = require(workerData.index);
+      const runner = new TFLiteNodeModelRunner(
+          new Uint8Array(workerData.shared), {});
+      runner.infer();
+      parentPort.postMessage(runner.getOutputs()[0].data().length);
+    `;
+    const worker = new Worker(script, {
+      eval: true,
+      workerData: {index: path.join(__dirname, 'index'), shared},
+    });
+    const length = await new Promise((resolve, reject) => {
+      worker.on('message', resolve);
+      worker.on('error', reject);
+    });
+
+    const runner = new TFLiteNodeModelRunner(new Uint8Array(shared), {});
+    expect(length).toEqual(runner.getOutputs()[0].data().length);
+  });
+
+  it('keeps Uint8Array models alive for the interpreters using them', () => {
+    const bytes = new Uint8Array(fs.readFileSync(
+        './test_data/mobilenet_v2_1.0_224_inat_bird_quant.tflite'));
+    const first = new TFLiteNodeModelRunner(bytes, {});
+    const second = new TFLiteNodeModelRunner(bytes.slice(), {});
+    const options = threadAffinity ? {affinity: {numaNode: 0}} : {};
+    const pinned = new TFLiteNodeModelRunner(bytes, options);
+    const lengths = [first, second, pinned].map(runner => {
+      runner.infer();
+      return runner.getOutputs()[0].data().length;
+    });
+    expect(lengths).toEqual([lengths[0], lengths[0], lengths[0]]);
+  });
 });
 
 // TODO(mattsoulanille): Move this to integration tests since it loads from
@@ -281,7 +281,7 @@ export class TFLiteModel implements InferenceModel {
     });
   }
 
-  private checkMapInputs(
+  protected checkMapInputs(
       inputTensorNames: string[], modelInputNames: string[]) {
     const notInModel =
         inputTensorNames.filter(name => !modelInputNames.includes(name));
@@ -302,11 +302,11 @@ export class TFLiteModel implements InferenceModel {
     throw new Error(msgParts.join(' '));
   }
 
-  private getShapeFromTFLiteTensorInfo(info: TFLiteWebModelRunnerTensorInfo) {
+  protected getShapeFromTFLiteTensorInfo(info: TFLiteWebModelRunnerTensorInfo) {
     return info.shape.split(',').map(s => Number(s));
   }
 
-  private getDataTypeMismatchError(expected: string, got: string) {
+  protected getDataTypeMismatchError(expected: string, got: string) {
     return new Error(
         `Data type mismatch: input tensor expects '${expected}', got '${got}'`);
   }
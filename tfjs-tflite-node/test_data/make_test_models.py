@@ -0,0 +1,183 @@
+# @license
+# Copyright 2022 Google LLC. All Rights Reserved.
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =============================================================================
+"""Writes the small pass-through models used by the tests.
+
+Each model copies its inputs to its outputs with RESHAPE ops, so tests can
+set known values on the inputs and read them back from the outputs:
+
+  detection_passthrough.tflite: float32 'boxes' [1, 4, 4] and 'scores'
+      [1, 4, 3] inputs to 'boxes_out' and 'scores_out', for detect().
+  string_passthrough.tflite: a string 'text' [2] input to a 'text_out'
+      output, for string tensors.
+
+The flatbuffers are built by hand, following the TFLite schema, so that only
+the Python standard library is needed:
+
+  python3 make_test_models.py
+"""
+
+import os
+import struct
+
+RESHAPE = 22
+FLOAT32 = 0
+INT32 = 2
+STRING = 5
+
+
+class Table(object):
+  """Fields as (id, format, value). Tables, vectors and strings are values."""
+
+  def __init__(self, *fields):
+    self.fields = [f for f in fields if f[2] is not None]
+
+
+class Vector(object):
+  """A vector of scalars with a struct format, or of tables if None."""
+
+  def __init__(self, fmt, items):
+    self.fmt = fmt
+    self.items = items
+
+
+class Writer(object):
+  """Lays out a flatbuffer front to back, children after their parents, so
+  every offset points forward as the format requires."""
+
+  def __init__(self):
+    self.buf = bytearray()
+
+  def align(self, n):
+    while len(self.buf) % n:
+      self.buf.append(0)
+
+  def patch(self, at, target):
+    struct.pack_into('<I', self.buf, at, target - at)
+
+  def write(self, value):
+    if isinstance(value, Table):
+      return self.table(value)
+    if isinstance(value, Vector):
+      return self.vector(value)
+    return self.vector(Vector('B', bytearray(value.encode()) + b'\0'), 1)
+
+  def table(self, table):
+    # Offsets first, then scalars by decreasing size, keeps fields aligned.
+    def size(field):
+      return 4 if field[1] == 'offset' else struct.calcsize(field[1])
+    fields = sorted(table.fields, key=lambda f: -size(f))
+    slots = max([f[0] for f in fields] + [-1]) + 1
+    self.align(2)
+    vtable = len(self.buf)
+    self.buf += bytes(4 + 2 * slots)
+    self.align(4)
+    start = len(self.buf)
+    self.buf += struct.pack('<i', start - vtable)
+    children = []
+    for field in fields:
+      struct.pack_into('<H', self.buf, vtable + 4 + 2 * field[0],
+                       len(self.buf) - start)
+      if field[1] == 'offset':
+        children.append((len(self.buf), field[2]))
+        self.buf += bytes(4)
+      else:
+        self.buf += struct.pack('<' + field[1], field[2])
+    struct.pack_into('<HH', self.buf, vtable, 4 + 2 * slots,
+                     len(self.buf) - start)
+    for at, child in children:
+      self.patch(at, self.write(child))
+    return start
+
+  def vector(self, vector, terminator=0):
+    # Only vectors of 4 byte or smaller elements are needed here.
+    self.align(4)
+    start = len(self.buf)
+    count = len(vector.items) - terminator
+    self.buf += struct.pack('<I', count)
+    if vector.fmt is None:
+      slots = []
+      for _ in vector.items:
+        slots.append(len(self.buf))
+        self.buf += bytes(4)
+      for at, item in zip(slots, vector.items):
+        self.patch(at, self.write(item))
+    else:
+      self.buf += struct.pack('<%d%s' % (len(vector.items), vector.fmt),
+                              *vector.items)
+    return start
+
+  def finish(self, root):
+    self.buf += bytes(4) + b'TFL3'
+    self.patch(0, self.write(root))
+    return bytes(self.buf)
+
+
+def tensor(name, shape, dtype, buffer=0):
+  return Table((0, 'offset', Vector('i', shape)), (1, 'b', dtype),
+               (2, 'I', buffer), (3, 'offset', name))
+
+
+def passthrough_model(description, specs):
+  """A model with an input and an output per (name, out_name, shape, type)."""
+  tensors, inputs, outputs, operators = [], [], [], []
+  buffers = [Table()]
+  for name, out_name, shape, dtype in specs:
+    buffers.append(Table((0, 'offset', Vector(
+        'B', bytearray(struct.pack('<%di' % len(shape), *shape))))))
+    first = len(tensors)
+    tensors += [
+        tensor(name, shape, dtype),
+        tensor(name + '/shape', [len(shape)], INT32, len(buffers) - 1),
+        tensor(out_name, shape, dtype),
+    ]
+    inputs.append(first)
+    outputs.append(first + 2)
+    operators.append(Table((0, 'I', 0),
+                           (1, 'offset', Vector('i', [first, first + 1])),
+                           (2, 'offset', Vector('i', [first + 2]))))
+  subgraph = Table((0, 'offset', Vector(None, tensors)),
+                   (1, 'offset', Vector('i', inputs)),
+                   (2, 'offset', Vector('i', outputs)),
+                   (3, 'offset', Vector(None, operators)),
+                   (4, 'offset', 'main'))
+  opcode = Table((0, 'b', RESHAPE), (2, 'i', 1), (3, 'i', RESHAPE))
+  model = Table((0, 'I', 3),
+                (1, 'offset', Vector(None, [opcode])),
+                (2, 'offset', Vector(None, [subgraph])),
+                (3, 'offset', description),
+                (4, 'offset', Vector(None, buffers)))
+  return Writer().finish(model)
+
+
+def main():
+  here = os.path.dirname(os.path.abspath(__file__))
+  models = {
+      'detection_passthrough.tflite': passthrough_model(
+          'Copies SSD style boxes and scores to its outputs', [
+              ('boxes', 'boxes_out', [1, 4, 4], FLOAT32),
+              ('scores', 'scores_out', [1, 4, 3], FLOAT32),
+          ]),
+      'string_passthrough.tflite': passthrough_model(
+          'Copies strings to its output', [
+              ('text', 'text_out', [2], STRING),
+          ]),
+  }
+  for name, data in models.items():
+    with open(os.path.join(here, name), 'wb') as f:
+      f.write(data)
+
+
+if __name__ == '__main__':
+  main()